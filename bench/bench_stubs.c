@@ -0,0 +1,638 @@
+/*------------------------------------------------------------------------
+ * bench_stubs.c
+ *              Stand-ins for the backend functions used by the Linux
+ *              collectors, so they can be benchmarked outside a server
+ *
+ * Memory contexts keep their chunks in a list so a reset frees them, error
+ * reports below ERROR are dropped and hash tables are simple chained
+ * tables. Every heap allocation, including the ones libc makes for stdio,
+ * is counted by wrapping malloc.
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+#include "bench_stubs.h"
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "nodes/pg_list.h"
+#include "storage/fd.h"
+#include "storage/latch.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+#include "utils/varlena.h"
+
+#define BENCH_HASH_BUCKETS      256
+#define BENCH_MAX_EXTERNAL_FDS  64
+
+/* entry points of the glibc allocator, used by the malloc wrappers */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+/* header put in front of every chunk allocated in a memory context */
+typedef struct bench_chunk
+{
+	struct bench_chunk *prev;
+	struct bench_chunk *next;
+	struct bench_context *context;
+	Size        size;
+} bench_chunk;
+
+/* memory context, only ever used through the opaque MemoryContext pointer */
+typedef struct bench_context
+{
+	const char  *name;
+	bench_chunk *chunks;
+} bench_context;
+
+typedef struct bench_hash_entry
+{
+	struct bench_hash_entry *next;
+	uint32      hashvalue;
+	/* entry of the caller follows, MAXALIGN'd */
+} bench_hash_entry;
+
+struct HTAB
+{
+	MemoryContext    hcxt;
+	Size             keysize;
+	Size             entrysize;
+	bool             string_keys;
+	bench_hash_entry *buckets[BENCH_HASH_BUCKETS];
+};
+
+#define HASH_ENTRY_DATA(e)  ((char *) (e) + MAXALIGN(sizeof(bench_hash_entry)))
+
+uint64 bench_alloc_count = 0;
+uint64 bench_row_count = 0;
+
+pid_t PostmasterPid = 0;
+struct Latch *MyLatch = NULL;
+volatile sig_atomic_t InterruptPending = false;
+MemoryContext CurrentMemoryContext = NULL;
+MemoryContext TopMemoryContext = NULL;
+char *GUC_check_errdetail_string = NULL;
+
+static TimestampTz statement_start_timestamp = 0;
+static int num_external_fds = 0;
+
+static void *context_alloc(bench_context *context, Size size);
+static uint32 bench_hash_key(HTAB *hashp, const void *keyPtr);
+static bool bench_hash_match(HTAB *hashp, const void *entry_key, const void *keyPtr);
+
+/* malloc wrappers, so allocations made by libc itself are counted too */
+void *malloc(size_t size)
+{
+	bench_alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	bench_alloc_count++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	bench_alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+
+void bench_init(void)
+{
+	TopMemoryContext = AllocSetContextCreate(NULL, "TopMemoryContext", ALLOCSET_DEFAULT_SIZES);
+	CurrentMemoryContext = TopMemoryContext;
+
+	/* the processes started by the parent stand for the backends */
+	PostmasterPid = getppid();
+}
+
+void bench_new_statement(void)
+{
+	statement_start_timestamp = GetCurrentTimestamp();
+}
+
+/* Memory contexts */
+static void *context_alloc(bench_context *context, Size size)
+{
+	bench_chunk *chunk = (bench_chunk *) malloc(MAXALIGN(sizeof(bench_chunk)) + size);
+
+	if (chunk == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	chunk->context = context;
+	chunk->size = size;
+	chunk->prev = NULL;
+	chunk->next = context->chunks;
+	if (context->chunks != NULL)
+		context->chunks->prev = chunk;
+	context->chunks = chunk;
+
+	return (char *) chunk + MAXALIGN(sizeof(bench_chunk));
+}
+
+MemoryContext AllocSetContextCreateInternal(MemoryContext parent, const char *name,
+											Size minContextSize, Size initBlockSize,
+											Size maxBlockSize)
+{
+	bench_context *context = (bench_context *) malloc(sizeof(bench_context));
+
+	context->name = name;
+	context->chunks = NULL;
+
+	return (MemoryContext) context;
+}
+
+void MemoryContextReset(MemoryContext context)
+{
+	bench_context *bcontext = (bench_context *) context;
+
+	while (bcontext->chunks != NULL)
+	{
+		bench_chunk *next = bcontext->chunks->next;
+
+		free(bcontext->chunks);
+		bcontext->chunks = next;
+	}
+}
+
+void *palloc(Size size)
+{
+	return context_alloc((bench_context *) CurrentMemoryContext, size);
+}
+
+void *palloc0(Size size)
+{
+	void *pointer = palloc(size);
+
+	memset(pointer, 0, size);
+	return pointer;
+}
+
+void *MemoryContextAlloc(MemoryContext context, Size size)
+{
+	return context_alloc((bench_context *) context, size);
+}
+
+void *MemoryContextAllocZero(MemoryContext context, Size size)
+{
+	void *pointer = MemoryContextAlloc(context, size);
+
+	memset(pointer, 0, size);
+	return pointer;
+}
+
+void pfree(void *pointer)
+{
+	bench_chunk *chunk = (bench_chunk *) ((char *) pointer - MAXALIGN(sizeof(bench_chunk)));
+
+	if (chunk->prev != NULL)
+		chunk->prev->next = chunk->next;
+	else
+		chunk->context->chunks = chunk->next;
+	if (chunk->next != NULL)
+		chunk->next->prev = chunk->prev;
+
+	free(chunk);
+}
+
+void *repalloc(void *pointer, Size size)
+{
+	bench_chunk *chunk = (bench_chunk *) ((char *) pointer - MAXALIGN(sizeof(bench_chunk)));
+	void        *newpointer = context_alloc(chunk->context, size);
+
+	memcpy(newpointer, pointer, Min(size, chunk->size));
+	pfree(pointer);
+
+	return newpointer;
+}
+
+char *pstrdup(const char *in)
+{
+	return pnstrdup(in, strlen(in));
+}
+
+char *pnstrdup(const char *in, Size len)
+{
+	char *out;
+
+	len = strnlen(in, len);
+	out = palloc(len + 1);
+	memcpy(out, in, len);
+	out[len] = '\0';
+
+	return out;
+}
+
+text *cstring_to_text(const char *s)
+{
+	int  len = strlen(s);
+	text *result = (text *) palloc(len + VARHDRSZ);
+
+	SET_VARSIZE(result, len + VARHDRSZ);
+	memcpy(VARDATA(result), s, len);
+
+	return result;
+}
+
+/* Error reports, anything at ERROR or above ends the benchmark */
+bool errstart(int elevel, const char *domain)
+{
+	return elevel >= ERROR;
+}
+
+bool errstart_cold(int elevel, const char *domain)
+{
+	return errstart(elevel, domain);
+}
+
+void errfinish(const char *filename, int lineno, const char *funcname)
+{
+	fprintf(stderr, "error reported at %s:%d in %s\n", filename, lineno, funcname);
+	exit(1);
+}
+
+int errcode(int sqlerrcode)
+{
+	return 0;
+}
+
+int errcode_for_file_access(void)
+{
+	return 0;
+}
+
+int errmsg(const char *fmt,...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+
+	return 0;
+}
+
+int errmsg_internal(const char *fmt,...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+
+	return 0;
+}
+
+int errdetail(const char *fmt,...)
+{
+	return 0;
+}
+
+void pre_format_elog_string(int errnumber, const char *domain)
+{
+}
+
+char *format_elog_string(const char *fmt,...)
+{
+	return NULL;
+}
+
+/* Result rows are only counted */
+void tuplestore_putvalues(Tuplestorestate *state, TupleDesc tdesc,
+						  Datum *values, bool *isnull)
+{
+	bench_row_count++;
+}
+
+/* Hash tables */
+static uint32 bench_hash_key(HTAB *hashp, const void *keyPtr)
+{
+	const unsigned char *key = (const unsigned char *) keyPtr;
+	Size   len = hashp->string_keys ? strnlen(keyPtr, hashp->keysize - 1) : hashp->keysize;
+	uint32 hashvalue = 2166136261u;
+	Size   i;
+
+	for (i = 0; i < len; i++)
+		hashvalue = (hashvalue ^ key[i]) * 16777619u;
+
+	return hashvalue;
+}
+
+static bool bench_hash_match(HTAB *hashp, const void *entry_key, const void *keyPtr)
+{
+	if (hashp->string_keys)
+		return strncmp(entry_key, keyPtr, hashp->keysize - 1) == 0;
+
+	return memcmp(entry_key, keyPtr, hashp->keysize) == 0;
+}
+
+HTAB *hash_create(const char *tabname, long nelem, const HASHCTL *info, int flags)
+{
+	MemoryContext hcxt = (flags & HASH_CONTEXT) ? info->hcxt : TopMemoryContext;
+	HTAB          *hashp = (HTAB *) MemoryContextAllocZero(hcxt, sizeof(HTAB));
+
+	hashp->hcxt = hcxt;
+	hashp->keysize = info->keysize;
+	hashp->entrysize = info->entrysize;
+	hashp->string_keys = (flags & HASH_BLOBS) == 0;
+
+	return hashp;
+}
+
+void *hash_search(HTAB *hashp, const void *keyPtr, HASHACTION action, bool *foundPtr)
+{
+	uint32           hashvalue = bench_hash_key(hashp, keyPtr);
+	bench_hash_entry **link = &hashp->buckets[hashvalue % BENCH_HASH_BUCKETS];
+	bench_hash_entry *entry;
+
+	for (entry = *link; entry != NULL; link = &entry->next, entry = entry->next)
+	{
+		if (entry->hashvalue == hashvalue &&
+			bench_hash_match(hashp, HASH_ENTRY_DATA(entry), keyPtr))
+			break;
+	}
+
+	if (foundPtr != NULL)
+		*foundPtr = (entry != NULL);
+
+	if (entry != NULL)
+	{
+		/* the removed entry stays valid until its context is reset */
+		if (action == HASH_REMOVE)
+			*link = entry->next;
+		return HASH_ENTRY_DATA(entry);
+	}
+
+	if (action != HASH_ENTER && action != HASH_ENTER_NULL)
+		return NULL;
+
+	entry = (bench_hash_entry *) MemoryContextAllocZero(hashp->hcxt,
+														MAXALIGN(sizeof(bench_hash_entry)) + hashp->entrysize);
+	entry->hashvalue = hashvalue;
+	entry->next = *link;
+	*link = entry;
+
+	if (hashp->string_keys)
+		strlcpy(HASH_ENTRY_DATA(entry), keyPtr, hashp->keysize);
+	else
+		memcpy(HASH_ENTRY_DATA(entry), keyPtr, hashp->keysize);
+
+	return HASH_ENTRY_DATA(entry);
+}
+
+void hash_seq_init(HASH_SEQ_STATUS *status, HTAB *hashp)
+{
+	status->hashp = hashp;
+	status->curBucket = 0;
+	status->curEntry = NULL;
+}
+
+void *hash_seq_search(HASH_SEQ_STATUS *status)
+{
+	bench_hash_entry *entry = (bench_hash_entry *) status->curEntry;
+
+	if (entry != NULL)
+		entry = entry->next;
+
+	while (entry == NULL && status->curBucket < BENCH_HASH_BUCKETS)
+		entry = status->hashp->buckets[status->curBucket++];
+
+	status->curEntry = (HASHELEMENT *) entry;
+
+	return (entry != NULL) ? HASH_ENTRY_DATA(entry) : NULL;
+}
+
+void hash_destroy(HTAB *hashp)
+{
+	int i;
+
+	for (i = 0; i < BENCH_HASH_BUCKETS; i++)
+	{
+		while (hashp->buckets[i] != NULL)
+		{
+			bench_hash_entry *next = hashp->buckets[i]->next;
+
+			pfree(hashp->buckets[i]);
+			hashp->buckets[i] = next;
+		}
+	}
+
+	pfree(hashp);
+}
+
+/* Timestamps */
+TimestampTz GetCurrentTimestamp(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return (TimestampTz) ts.tv_sec * USECS_PER_SEC + ts.tv_nsec / 1000 -
+		((POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * SECS_PER_DAY * USECS_PER_SEC);
+}
+
+TimestampTz GetCurrentStatementStartTimestamp(void)
+{
+	return statement_start_timestamp;
+}
+
+long TimestampDifferenceMilliseconds(TimestampTz start_time, TimestampTz stop_time)
+{
+	if (stop_time <= start_time)
+		return 0;
+
+	return (long) ((stop_time - start_time + 999) / 1000);
+}
+
+bool TimestampDifferenceExceeds(TimestampTz start_time, TimestampTz stop_time, int msec)
+{
+	return (stop_time - start_time) >= (TimestampTz) msec * 1000;
+}
+
+/* File descriptors opened outside of fd.c */
+bool AcquireExternalFD(void)
+{
+	if (num_external_fds >= BENCH_MAX_EXTERNAL_FDS)
+		return false;
+
+	num_external_fds++;
+	return true;
+}
+
+void ReserveExternalFD(void)
+{
+	num_external_fds++;
+}
+
+void ReleaseExternalFD(void)
+{
+	num_external_fds--;
+}
+
+/* Transient files are plain descriptors, there is no transaction to end */
+int OpenTransientFile(const char *fileName, int fileFlags)
+{
+	return open(fileName, fileFlags, 0600);
+}
+
+int CloseTransientFile(int fd)
+{
+	return close(fd);
+}
+
+/* There is no latch to set, so the waits of the collectors sleep their timeout */
+int WaitLatch(struct Latch *latch, int wakeEvents, long timeout, uint32 wait_event_info)
+{
+	if (timeout > 0)
+		usleep(timeout * 1000L);
+
+	return WL_TIMEOUT;
+}
+
+void ResetLatch(struct Latch *latch)
+{
+}
+
+void ProcessInterrupts(void)
+{
+}
+
+/* GUCs keep their boot value */
+void DefineCustomStringVariable(const char *name, const char *short_desc,
+								const char *long_desc, char **valueAddr,
+								const char *bootValue, GucContext context,
+								int flags, GucStringCheckHook check_hook,
+								GucStringAssignHook assign_hook,
+								GucShowHook show_hook)
+{
+	*valueAddr = bootValue ? pstrdup(bootValue) : NULL;
+}
+
+void DefineCustomIntVariable(const char *name, const char *short_desc,
+							 const char *long_desc, int *valueAddr,
+							 int bootValue, int minValue, int maxValue,
+							 GucContext context, int flags,
+							 GucIntCheckHook check_hook,
+							 GucIntAssignHook assign_hook,
+							 GucShowHook show_hook)
+{
+	*valueAddr = bootValue;
+}
+
+void DefineCustomBoolVariable(const char *name, const char *short_desc,
+							  const char *long_desc, bool *valueAddr,
+							  bool bootValue, GucContext context, int flags,
+							  GucBoolCheckHook check_hook,
+							  GucBoolAssignHook assign_hook,
+							  GucShowHook show_hook)
+{
+	*valueAddr = bootValue;
+}
+
+/* Lists, with the array based layout of PostgreSQL 13 and later */
+List *lappend(List *list, void *datum)
+{
+	if (list == NIL)
+	{
+		list = (List *) palloc(offsetof(List, initial_elements) + 8 * sizeof(ListCell));
+		list->type = T_List;
+		list->length = 0;
+		list->max_length = 8;
+		list->elements = list->initial_elements;
+	}
+	else if (list->length >= list->max_length)
+	{
+		ListCell *elements = (ListCell *) palloc(list->max_length * 2 * sizeof(ListCell));
+
+		memcpy(elements, list->elements, list->length * sizeof(ListCell));
+		if (list->elements != list->initial_elements)
+			pfree(list->elements);
+		list->elements = elements;
+		list->max_length *= 2;
+	}
+
+	list->elements[list->length++].ptr_value = datum;
+
+	return list;
+}
+
+void list_free(List *list)
+{
+	if (list == NIL)
+		return;
+
+	if (list->elements != list->initial_elements)
+		pfree(list->elements);
+	pfree(list);
+}
+
+/* Split a GUC list, without the double quoting handled by the backend */
+bool SplitGUCList(char *rawstring, char separator, List **namelist)
+{
+	char *nextp = rawstring;
+
+	*namelist = NIL;
+
+	while (*nextp != '\0')
+	{
+		char *curname;
+		char *endp;
+
+		while (isspace((unsigned char) *nextp))
+			nextp++;
+
+		curname = nextp;
+		while (*nextp != '\0' && *nextp != separator)
+			nextp++;
+
+		endp = nextp;
+		while (endp > curname && isspace((unsigned char) endp[-1]))
+			endp--;
+
+		if (*nextp == separator)
+			nextp++;
+		*endp = '\0';
+
+		if (*curname != '\0')
+			*namelist = lappend(*namelist, curname);
+	}
+
+	return true;
+}
+
+/* The background sampler never runs in the benchmark */
+bool ReadLatestCPUSamples(struct cpu_stat *first_sample, struct cpu_stat *second_sample)
+{
+	return false;
+}
+
+bool ReadLatestPressureSamples(pressure_sample *first_sample, pressure_sample *second_sample)
+{
+	return false;
+}
@@ -0,0 +1,25 @@
+/*------------------------------------------------------------------------
+ * bench_stubs.h
+ *              Counters and helpers of the backend stand-ins used by the
+ *              collector microbenchmark
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+#ifndef BENCH_STUBS_H
+#define BENCH_STUBS_H
+
+/* number of heap allocations, including the ones made inside libc */
+extern uint64 bench_alloc_count;
+
+/* number of rows put in the tuple store */
+extern uint64 bench_row_count;
+
+/* initialize the memory contexts, must be called before any collector */
+void bench_init(void);
+
+/* start a new statement, so per-statement caches are not reused */
+void bench_new_statement(void);
+
+#endif // BENCH_STUBS_H
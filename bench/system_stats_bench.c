@@ -0,0 +1,302 @@
+/*------------------------------------------------------------------------
+ * system_stats_bench.c
+ *              Standalone microbenchmark of the Linux collectors
+ *
+ * Every collector is called N times, each call being a new statement run
+ * in a memory context reset afterwards, as the executor would. Reports the
+ * mean, p50 and p99 time per call, the heap allocations and rows per call
+ * and, when the process is allowed to trace itself, the system calls per
+ * call counted with ptrace.
+ *
+ * Usage: system_stats_bench [-n iterations] [collector ...]
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+#include "bench_stubs.h"
+
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+#include "utils/memutils.h"
+
+#define BENCH_DEFAULT_ITERATIONS        100
+#define BENCH_SYSCALL_ITERATIONS        10
+
+typedef void (*collector_function) (Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+typedef struct bench_collector
+{
+	const char          *name;
+	collector_function  collect;
+} bench_collector;
+
+static void bench_cpu_memory_by_process_pids(Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void bench_cpu_memory_by_process_name(Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void bench_top_processes(Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void bench_thread_stats(Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void bench_interrupts_info(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+static const bench_collector collectors[] =
+{
+	{"disk_info", ReadDiskInformation},
+	{"io_analysis_info", ReadIOAnalysisInformation},
+	{"cpu_info", ReadCPUInformation},
+	{"memory_info", ReadMemoryInformation},
+	{"load_avg_info", ReadLoadAvgInformations},
+	{"os_info", ReadOSInformations},
+	{"cpu_usage_info", ReadCPUUsageStatistics},
+	{"cpu_usage_per_core", ReadCPUUsagePerCore},
+	{"memory_info_detailed", ReadMemoryInformationDetailed},
+	{"process_info", ReadProcessInformations},
+	{"network_info", ReadNetworkInformations},
+	{"cpu_memory_by_process", ReadCPUMemoryByProcess},
+	{"cpu_memory_by_process_pids", bench_cpu_memory_by_process_pids},
+	{"cpu_memory_by_process_name", bench_cpu_memory_by_process_name},
+	{"top_processes", bench_top_processes},
+	{"backend_resource_usage", ReadBackendResourceUsage},
+	{"io_rates", ReadIORates},
+	{"pressure_info", ReadPressureInformation},
+	{"cgroup_info", ReadCgroupInformation},
+	{"thread_stats", bench_thread_stats},
+	{"backend_scheduler_stats", ReadBackendSchedulerStatistics},
+	{"backend_io", ReadBackendIOStatistics},
+	{"backend_memory", ReadBackendMemoryStatistics},
+	{"numa_info", ReadNumaInformation},
+	{"huge_pages_info", ReadHugePagesInformation},
+	{"shared_memory_info", ReadSharedMemoryInformation},
+	{"interrupts_info", bench_interrupts_info},
+	{"vmstat", ReadVmstatInformation},
+	{NULL, NULL}
+};
+
+static MemoryContext per_call_context = NULL;
+
+static void run_collector(const bench_collector *collector);
+static uint64 elapsed_ns(const struct timespec *start, const struct timespec *stop);
+static int compare_uint64(const void *a, const void *b);
+static double count_syscalls(const bench_collector *collector, int iterations);
+static void bench_collector_run(const bench_collector *collector, int iterations);
+
+/* Collectors taking arguments, called as their SQL examples in README.md */
+static void bench_cpu_memory_by_process_pids(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	int pids[1];
+
+	pids[0] = getpid();
+	ReadCPUMemoryByProcessPids(tupstore, tupdesc, pids, 1);
+}
+
+static void bench_cpu_memory_by_process_name(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ReadCPUMemoryByProcessName(tupstore, tupdesc, "postgres%");
+}
+
+static void bench_top_processes(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ReadTopProcesses(tupstore, tupdesc, 10, PROCESS_ORDER_CPU);
+}
+
+static void bench_thread_stats(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ReadThreadStatistics(tupstore, tupdesc, getpid(), 10);
+}
+
+static void bench_interrupts_info(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ReadInterruptsInformation(tupstore, tupdesc, 10);
+}
+
+/* Call the collector once, as one statement of its own */
+static void run_collector(const bench_collector *collector)
+{
+	MemoryContext oldcontext;
+
+	bench_new_statement();
+
+	oldcontext = MemoryContextSwitchTo(per_call_context);
+	collector->collect(NULL, NULL);
+	MemoryContextSwitchTo(oldcontext);
+
+	MemoryContextReset(per_call_context);
+}
+
+static uint64 elapsed_ns(const struct timespec *start, const struct timespec *stop)
+{
+	return (uint64) (stop->tv_sec - start->tv_sec) * 1000000000 +
+		(stop->tv_nsec - start->tv_nsec);
+}
+
+static int compare_uint64(const void *a, const void *b)
+{
+	uint64 left = *(const uint64 *) a;
+	uint64 right = *(const uint64 *) b;
+
+	return (left > right) - (left < right);
+}
+
+/*
+ * Count the system calls made by given number of calls of the collector,
+ * in a child process traced with ptrace. The child makes one call before
+ * the tracing starts, so one time initialization is not counted. Returns
+ * -1 if the child can not be traced, e.g. in a container without the
+ * CAP_SYS_PTRACE capability and with a strict Yama policy.
+ */
+static double count_syscalls(const bench_collector *collector, int iterations)
+{
+	pid_t  child;
+	int    status = 0;
+	int    signo = 0;
+	uint64 stops = 0;
+	int    i;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	child = fork();
+	if (child < 0)
+		return -1;
+
+	if (child == 0)
+	{
+		run_collector(collector);
+
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) < 0)
+			_exit(2);
+		raise(SIGSTOP);
+
+		for (i = 0; i < iterations; i++)
+			run_collector(collector);
+
+		_exit(0);
+	}
+
+	if (waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status))
+		return -1;
+
+	ptrace(PTRACE_SETOPTIONS, child, NULL, (void *) PTRACE_O_TRACESYSGOOD);
+
+	for (;;)
+	{
+		if (ptrace(PTRACE_SYSCALL, child, NULL, (void *) (long) signo) < 0)
+			break;
+		if (waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status))
+			break;
+
+		/* pass any other signal on to the child */
+		signo = 0;
+		if (WSTOPSIG(status) == (SIGTRAP | 0x80))
+			stops++;
+		else
+			signo = WSTOPSIG(status);
+	}
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || stops < 1)
+		return -1;
+
+	/*
+	 * Each system call stops once on entry and once on exit, except the
+	 * final exit_group which never returns.
+	 */
+	return (double) (stops - 1) / 2 / iterations;
+}
+
+static void bench_collector_run(const bench_collector *collector, int iterations)
+{
+	uint64          *samples = (uint64 *) malloc(iterations * sizeof(uint64));
+	uint64          total_ns = 0;
+	uint64          allocs;
+	uint64          rows;
+	double          syscalls;
+	struct timespec start;
+	struct timespec stop;
+	int             i;
+
+	/* warm up, one time initialization is not part of the measure */
+	run_collector(collector);
+
+	allocs = bench_alloc_count;
+	rows = bench_row_count;
+
+	for (i = 0; i < iterations; i++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		run_collector(collector);
+		clock_gettime(CLOCK_MONOTONIC, &stop);
+
+		samples[i] = elapsed_ns(&start, &stop);
+		total_ns += samples[i];
+	}
+
+	allocs = bench_alloc_count - allocs;
+	rows = bench_row_count - rows;
+
+	qsort(samples, iterations, sizeof(uint64), compare_uint64);
+
+	syscalls = count_syscalls(collector, Min(iterations, BENCH_SYSCALL_ITERATIONS));
+
+	printf("%-28s %8d %12.0f %12" PRIu64 " %12" PRIu64 " %10.1f %10.1f ",
+		   collector->name, iterations,
+		   (double) total_ns / iterations,
+		   samples[(iterations - 1) / 2],
+		   samples[(iterations * 99 - 1) / 100],
+		   (double) allocs / iterations,
+		   (double) rows / iterations);
+
+	if (syscalls < 0)
+		printf("%10s\n", "n/a");
+	else
+		printf("%10.1f\n", syscalls);
+
+	free(samples);
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = BENCH_DEFAULT_ITERATIONS;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1)
+	{
+		if (opt == 'n' && atoi(optarg) > 0)
+			iterations = atoi(optarg);
+		else
+		{
+			fprintf(stderr, "usage: %s [-n iterations] [collector ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bench_init();
+	per_call_context = AllocSetContextCreate(TopMemoryContext,
+											 "per call",
+											 ALLOCSET_DEFAULT_SIZES);
+	InitDiskInfoFilters();
+	InitCgroupInfo();
+
+	printf("%-28s %8s %12s %12s %12s %10s %10s %10s\n",
+		   "collector", "calls", "mean ns", "p50 ns", "p99 ns",
+		   "allocs", "rows", "syscalls");
+
+	for (i = 0; collectors[i].name != NULL; i++)
+	{
+		int arg;
+		bool selected = (optind >= argc);
+
+		for (arg = optind; arg < argc && !selected; arg++)
+			selected = (strcmp(argv[arg], collectors[i].name) == 0);
+
+		if (selected)
+			bench_collector_run(&collectors[i], iterations);
+	}
+
+	return 0;
+}
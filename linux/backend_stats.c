@@ -0,0 +1,794 @@
+/*------------------------------------------------------------------------
+ * backend_stats.c
+ *              Scheduler, I/O and memory statistics of the backends
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include <fcntl.h>
+
+/* interval between two samples when there is no recent previous sample */
+#define BACKEND_SAMPLE_INTERVAL_MS    100
+/* size of the buffer used to read /proc/<pid>/status */
+#define PROCESS_STATUS_BUF_SIZE       4096
+
+/* structure used to walk the backends, see BackendProcOpen */
+typedef struct backend_proc_reader
+{
+	process_snapshot snapshot;
+	int              proc_fd;
+	int              next_entry;
+} backend_proc_reader;
+
+/* scheduler statistics and page faults of one backend */
+typedef struct backend_sched_stat
+{
+	int                    pid;
+	unsigned long long     start_time;
+	char                   state;
+	char                   name[PROCESS_NAME_LEN];
+	bool                   has_schedstat;
+	bool                   has_ctxt_switches;
+	unsigned long long     run_time_ns;
+	unsigned long long     run_delay_ns;
+	unsigned long long     timeslices;
+	unsigned long long     voluntary_switches;
+	unsigned long long     involuntary_switches;
+	unsigned long long     minor_faults;
+	unsigned long long     major_faults;
+} backend_sched_stat;
+
+/* I/O counters of /proc/<pid>/io of one backend */
+typedef struct backend_io_stat
+{
+	int                    pid;
+	unsigned long long     start_time;
+	char                   name[PROCESS_NAME_LEN];
+	bool                   has_io;
+	unsigned long long     rchar;
+	unsigned long long     wchar;
+	unsigned long long     syscr;
+	unsigned long long     syscw;
+	unsigned long long     read_bytes;
+	unsigned long long     write_bytes;
+	unsigned long long     cancelled_write_bytes;
+} backend_io_stat;
+
+/* fields of /proc/<pid>/smaps_rollup reported by ReadBackendMemoryStatistics */
+typedef enum smaps_rollup_field
+{
+	SMAPS_RSS,
+	SMAPS_PSS,
+	SMAPS_PSS_ANON,
+	SMAPS_PSS_FILE,
+	SMAPS_PSS_SHMEM,
+	SMAPS_PRIVATE_CLEAN,
+	SMAPS_PRIVATE_DIRTY,
+	SMAPS_SWAP,
+	SMAPS_SWAP_PSS,
+	SMAPS_NUM_FIELDS
+} smaps_rollup_field;
+
+/* names of the fields, in the order of smaps_rollup_field */
+static const char *const smaps_rollup_field_names[SMAPS_NUM_FIELDS] = {
+	"Rss",
+	"Pss",
+	"Pss_Anon",
+	"Pss_File",
+	"Pss_Shmem",
+	"Private_Clean",
+	"Private_Dirty",
+	"Swap",
+	"SwapPss"
+};
+
+/* previous scheduler sample of the backends taken by this backend */
+static MemoryContext      BackendSchedContext = NULL;
+static backend_sched_stat *previous_sched_stats = NULL;
+static int                previous_num_sched_stats = 0;
+static TimestampTz        previous_sched_sample_time = 0;
+
+/* previous I/O sample of the backends taken by this backend */
+static MemoryContext   BackendIOContext = NULL;
+static backend_io_stat *previous_io_stats = NULL;
+static int             previous_num_io_stats = 0;
+static TimestampTz     previous_io_sample_time = 0;
+
+void ReadBackendSchedulerStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadBackendIOStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadBackendMemoryStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+static int *ReadPostmasterChildren(int *num_pids);
+static bool BackendProcOpen(backend_proc_reader *reader);
+static process_stat *BackendProcNext(backend_proc_reader *reader);
+static void BackendProcClose(backend_proc_reader *reader);
+static int take_backend_sched_sample(backend_sched_stat **sched_stats, TimestampTz *sample_time);
+static int compare_backend_sched_stat(const void *a, const void *b);
+static int take_backend_io_sample(backend_io_stat **io_stats, TimestampTz *sample_time);
+static int compare_backend_io_stat(const void *a, const void *b);
+static bool read_smaps_rollup(char *content, unsigned long long *values, bool *present);
+
+/*
+ * Read the pids of the children of the postmaster from
+ * /proc/<postmaster pid>/task/<tid>/children. Returns NULL if the kernel
+ * does not provide these files.
+ */
+static int *ReadPostmasterChildren(int *num_pids)
+{
+	proc_dir_reader reader;
+	const char      *tid_name;
+	char            path[MAXPGPATH];
+	int             *pids = NULL;
+	int             max_pids = 0;
+
+	*num_pids = 0;
+
+	snprintf(path, MAXPGPATH, "%s/%d/task", PROC_FILE_SYSTEM_PATH, (int) PostmasterPid);
+	if (!ProcDirOpen(&reader, path))
+		return NULL;
+
+	while ((tid_name = ProcDirNextNumericEntry(&reader)) != NULL)
+	{
+		char *children;
+		char *next;
+		char *end;
+		long pid;
+
+		snprintf(path, MAXPGPATH, "%s/%d/task/%s/children",
+				 PROC_FILE_SYSTEM_PATH, (int) PostmasterPid, tid_name);
+
+		children = ReadProcFile(path, NULL);
+		if (children == NULL)
+		{
+			ProcDirClose(&reader);
+			if (pids != NULL)
+				pfree(pids);
+			return NULL;
+		}
+
+		/* The file is a list of pids separated by spaces */
+		for (next = children; ; next = end)
+		{
+			pid = strtol(next, &end, 10);
+			if (end == next)
+				break;
+
+			if (*num_pids >= max_pids)
+			{
+				max_pids = Max(max_pids * 2, 64);
+				pids = (pids == NULL) ? (int *) palloc(max_pids * sizeof(int)) :
+					(int *) repalloc(pids, max_pids * sizeof(int));
+			}
+			pids[(*num_pids)++] = (int) pid;
+		}
+
+		pfree(children);
+	}
+
+	ProcDirClose(&reader);
+
+	if (pids == NULL)
+		pids = (int *) palloc(sizeof(int));
+
+	return pids;
+}
+
+/*
+ * The pids of the backends and other children of the postmaster. They are
+ * discovered from the children list the kernel keeps for the postmaster,
+ * so the cost depends on the number of connections and not on the number
+ * of processes of the system. When the kernel does not provide that list,
+ * the processes whose parent is the postmaster are taken from the process
+ * snapshot of the statement. Returns NULL if /proc can not be read.
+ */
+int *ReadBackendPids(int *num_pids)
+{
+	process_snapshot *snapshot;
+	int              *pids;
+	int              index;
+
+	pids = ReadPostmasterChildren(num_pids);
+	if (pids != NULL)
+		return pids;
+
+	ereport(DEBUG1,
+			(errmsg("can not read the children of the postmaster, reading all processes")));
+
+	*num_pids = 0;
+	snapshot = GetStatementProcessSnapshot();
+	if (snapshot == NULL)
+		return NULL;
+
+	pids = (int *) palloc(Max(snapshot->num_entries, 1) * sizeof(int));
+	for (index = 0; index < snapshot->num_entries; index++)
+	{
+		if (snapshot->entries[index].ppid == PostmasterPid)
+			pids[(*num_pids)++] = snapshot->entries[index].pid;
+	}
+
+	return pids;
+}
+
+/*
+ * Take a snapshot of /proc/<pid>/stat of the backends, see ReadBackendPids,
+ * and open /proc to read their other files relative to it. The descriptor
+ * of /proc is a transient file of the server, so it is released at the end
+ * of the transaction if an error is raised before BackendProcClose.
+ * Returns false if /proc can not be read.
+ */
+static bool BackendProcOpen(backend_proc_reader *reader)
+{
+	int *pids;
+	int num_pids = 0;
+
+	reader->next_entry = 0;
+
+	pids = ReadBackendPids(&num_pids);
+	if (pids == NULL)
+		return false;
+
+	reader->proc_fd = OpenTransientFile(PROC_FILE_SYSTEM_PATH, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (reader->proc_fd < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+					errmsg("can not open directory %s", PROC_FILE_SYSTEM_PATH)));
+		pfree(pids);
+		return false;
+	}
+
+	if (!TakeProcessSnapshotOfPids(&reader->snapshot, pids, num_pids))
+	{
+		CloseTransientFile(reader->proc_fd);
+		pfree(pids);
+		return false;
+	}
+
+	pfree(pids);
+
+	return true;
+}
+
+/*
+ * Return the entry of the next backend of the snapshot, or NULL once all
+ * were returned. A pid that was reused by a process outside the cluster
+ * since it was listed is skipped.
+ */
+static process_stat *BackendProcNext(backend_proc_reader *reader)
+{
+	process_stat *entry;
+
+	while (reader->next_entry < reader->snapshot.num_entries)
+	{
+		entry = &reader->snapshot.entries[reader->next_entry++];
+
+		if (entry->ppid == PostmasterPid)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void BackendProcClose(backend_proc_reader *reader)
+{
+	CloseTransientFile(reader->proc_fd);
+	FreeProcessSnapshot(&reader->snapshot);
+}
+
+static int compare_backend_sched_stat(const void *a, const void *b)
+{
+	int left = ((const backend_sched_stat *) a)->pid;
+	int right = ((const backend_sched_stat *) b)->pid;
+
+	return (left > right) - (left < right);
+}
+
+/*
+ * Read /proc/<pid>/stat, /proc/<pid>/schedstat and /proc/<pid>/status of
+ * the backends into a palloc'd array sorted by pid. schedstat holds the
+ * time spent running and waiting on a run queue in nanoseconds, and the
+ * number of timeslices run; it is missing when the kernel is built without
+ * scheduler statistics. Returns the number of backends, or -1 if /proc can
+ * not be read.
+ */
+static int take_backend_sched_sample(backend_sched_stat **sched_stats, TimestampTz *sample_time)
+{
+	backend_proc_reader reader;
+	process_stat        *entry;
+	backend_sched_stat  *stat;
+	int                 num_stats = 0;
+	char                file_name[MIN_BUFFER_SIZE];
+	char                buf[PROCESS_STATUS_BUF_SIZE];
+	char                *line;
+
+	if (!BackendProcOpen(&reader))
+		return -1;
+
+	*sample_time = reader.snapshot.snapshot_time;
+	*sched_stats = (backend_sched_stat *) palloc0(Max(reader.snapshot.num_entries, 1) * sizeof(backend_sched_stat));
+
+	while ((entry = BackendProcNext(&reader)) != NULL)
+	{
+		stat = &(*sched_stats)[num_stats++];
+		stat->pid = entry->pid;
+		stat->start_time = entry->start_time;
+		stat->state = entry->state;
+		memcpy(stat->name, entry->name, PROCESS_NAME_LEN);
+		stat->minor_faults = entry->minor_faults;
+		stat->major_faults = entry->major_faults;
+
+		snprintf(file_name, MIN_BUFFER_SIZE, "%d/schedstat", entry->pid);
+		if (ReadProcFileAt(reader.proc_fd, file_name, buf, sizeof(buf)) >= 0 &&
+			sscanf(buf, "%llu %llu %llu", &stat->run_time_ns, &stat->run_delay_ns,
+				   &stat->timeslices) == 3)
+			stat->has_schedstat = true;
+
+		snprintf(file_name, MIN_BUFFER_SIZE, "%d/status", entry->pid);
+		if (ReadProcFileAt(reader.proc_fd, file_name, buf, sizeof(buf)) >= 0 &&
+			(line = strstr(buf, "\nvoluntary_ctxt_switches:")) != NULL &&
+			sscanf(line, "\nvoluntary_ctxt_switches: %llu\nnonvoluntary_ctxt_switches: %llu",
+				   &stat->voluntary_switches, &stat->involuntary_switches) == 2)
+			stat->has_ctxt_switches = true;
+	}
+
+	BackendProcClose(&reader);
+
+	qsort(*sched_stats, num_stats, sizeof(backend_sched_stat), compare_backend_sched_stat);
+
+	return num_stats;
+}
+
+/*
+ * Scheduler latency, context switch and page fault rates of the backends.
+ * The share of the time each backend ran and waited on a run queue, the
+ * average wait per timeslice, and the rates of timeslices, voluntary and
+ * involuntary context switches and page faults are computed against the
+ * previous call of this backend when it is recent enough, so a monitoring
+ * session polling regularly gets the rates since its last poll without any
+ * wait, otherwise over BACKEND_SAMPLE_INTERVAL_MS. A backend
+ * started since the previous sample is charged all of its counters.
+ */
+void ReadBackendSchedulerStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum              values[Natts_backend_sched_stats];
+	bool               nulls[Natts_backend_sched_stats];
+	backend_sched_stat *current_stats;
+	backend_sched_stat *previous;
+	backend_sched_stat zero_stat;
+	TimestampTz        current_sample_time;
+	MemoryContext      oldcontext;
+	int                num_stats;
+	int                index;
+	float8             interval_ms;
+	float8             seconds;
+	char               state[2];
+
+	if (BackendSchedContext == NULL)
+		BackendSchedContext = AllocSetContextCreate(TopMemoryContext,
+													"system_stats scheduler sample",
+													ALLOCSET_DEFAULT_SIZES);
+
+	oldcontext = MemoryContextSwitchTo(BackendSchedContext);
+
+	if (previous_sched_stats == NULL ||
+		PreviousSampleExpired(previous_sched_sample_time))
+	{
+		if (previous_sched_stats != NULL)
+			pfree(previous_sched_stats);
+		previous_sched_stats = NULL;
+
+		previous_num_sched_stats = take_backend_sched_sample(&previous_sched_stats,
+															 &previous_sched_sample_time);
+		if (previous_num_sched_stats < 0)
+		{
+			previous_sched_stats = NULL;
+			MemoryContextSwitchTo(oldcontext);
+			return;
+		}
+	}
+
+	/* Wait for the part of the sampling interval that has not elapsed yet */
+	WaitSampleInterval(previous_sched_sample_time, BACKEND_SAMPLE_INTERVAL_MS);
+
+	num_stats = take_backend_sched_sample(&current_stats, &current_sample_time);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (num_stats < 0)
+		return;
+
+	interval_ms = (current_sample_time - previous_sched_sample_time) / 1000.0;
+	seconds = interval_ms / 1000.0;
+	memset(&zero_stat, 0, sizeof(zero_stat));
+
+	for (index = 0; index < num_stats; index++)
+	{
+		backend_sched_stat *current = &current_stats[index];
+		backend_sched_stat key;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		key.pid = current->pid;
+		previous = (backend_sched_stat *) bsearch(&key, previous_sched_stats, previous_num_sched_stats,
+												  sizeof(backend_sched_stat), compare_backend_sched_stat);
+		if (previous == NULL || previous->start_time != current->start_time)
+			previous = &zero_stat;
+
+		state[0] = current->state;
+		state[1] = '\0';
+
+		values[Anum_sched_pid] = Int32GetDatum(current->pid);
+		values[Anum_sched_name] = CStringGetTextDatum(current->name);
+		values[Anum_sched_state] = CStringGetTextDatum(state);
+		values[Anum_sched_interval_ms] = Float8GetDatum(interval_ms);
+
+		if (current->has_schedstat && (previous == &zero_stat || previous->has_schedstat) && seconds > 0)
+		{
+			float8 run_time_ns = current->run_time_ns - Min(previous->run_time_ns, current->run_time_ns);
+			float8 run_delay_ns = current->run_delay_ns - Min(previous->run_delay_ns, current->run_delay_ns);
+			float8 timeslices = current->timeslices - Min(previous->timeslices, current->timeslices);
+
+			values[Anum_sched_run_time_percent] = Float8GetDatum(run_time_ns / (interval_ms * 10000.0));
+			values[Anum_sched_run_delay_percent] = Float8GetDatum(run_delay_ns / (interval_ms * 10000.0));
+			values[Anum_sched_timeslices_per_sec] = Float8GetDatum(timeslices / seconds);
+			if (timeslices > 0)
+				values[Anum_sched_avg_run_delay_us] = Float8GetDatum(run_delay_ns / timeslices / 1000.0);
+			else
+				nulls[Anum_sched_avg_run_delay_us] = true;
+		}
+		else
+		{
+			nulls[Anum_sched_run_time_percent] = true;
+			nulls[Anum_sched_run_delay_percent] = true;
+			nulls[Anum_sched_timeslices_per_sec] = true;
+			nulls[Anum_sched_avg_run_delay_us] = true;
+		}
+
+		if (current->has_ctxt_switches && (previous == &zero_stat || previous->has_ctxt_switches) &&
+			seconds > 0)
+		{
+			values[Anum_sched_voluntary_switches_per_sec] =
+				Float8GetDatum((current->voluntary_switches - Min(previous->voluntary_switches, current->voluntary_switches)) / seconds);
+			values[Anum_sched_involuntary_switches_per_sec] =
+				Float8GetDatum((current->involuntary_switches - Min(previous->involuntary_switches, current->involuntary_switches)) / seconds);
+		}
+		else
+		{
+			nulls[Anum_sched_voluntary_switches_per_sec] = true;
+			nulls[Anum_sched_involuntary_switches_per_sec] = true;
+		}
+
+		if (seconds > 0)
+		{
+			values[Anum_sched_minor_faults_per_sec] =
+				Float8GetDatum((current->minor_faults - Min(previous->minor_faults, current->minor_faults)) / seconds);
+			values[Anum_sched_major_faults_per_sec] =
+				Float8GetDatum((current->major_faults - Min(previous->major_faults, current->major_faults)) / seconds);
+		}
+		else
+		{
+			nulls[Anum_sched_minor_faults_per_sec] = true;
+			nulls[Anum_sched_major_faults_per_sec] = true;
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* The current sample is the previous one of the next call */
+	if (previous_sched_stats != NULL)
+		pfree(previous_sched_stats);
+	previous_sched_stats = current_stats;
+	previous_num_sched_stats = num_stats;
+	previous_sched_sample_time = current_sample_time;
+}
+
+static int compare_backend_io_stat(const void *a, const void *b)
+{
+	int left = ((const backend_io_stat *) a)->pid;
+	int right = ((const backend_io_stat *) b)->pid;
+
+	return (left > right) - (left < right);
+}
+
+/*
+ * Read /proc/<pid>/stat and /proc/<pid>/io of the backends into a palloc'd
+ * array sorted by pid. The io file of a process can only be read by its
+ * owner, and is missing when the kernel is built without task I/O
+ * accounting. Returns the number of backends, or -1 if /proc can not be
+ * read.
+ */
+static int take_backend_io_sample(backend_io_stat **io_stats, TimestampTz *sample_time)
+{
+	backend_proc_reader reader;
+	process_stat        *entry;
+	backend_io_stat     *stat;
+	int                 num_stats = 0;
+	char                file_name[MIN_BUFFER_SIZE];
+	char                buf[MAX_BUFFER_SIZE];
+
+	if (!BackendProcOpen(&reader))
+		return -1;
+
+	*sample_time = reader.snapshot.snapshot_time;
+	*io_stats = (backend_io_stat *) palloc0(Max(reader.snapshot.num_entries, 1) * sizeof(backend_io_stat));
+
+	while ((entry = BackendProcNext(&reader)) != NULL)
+	{
+		stat = &(*io_stats)[num_stats++];
+		stat->pid = entry->pid;
+		stat->start_time = entry->start_time;
+		memcpy(stat->name, entry->name, PROCESS_NAME_LEN);
+
+		snprintf(file_name, MIN_BUFFER_SIZE, "%d/io", entry->pid);
+		if (ReadProcFileAt(reader.proc_fd, file_name, buf, sizeof(buf)) >= 0 &&
+			sscanf(buf, "rchar: %llu wchar: %llu syscr: %llu syscw: %llu read_bytes: %llu"
+				   " write_bytes: %llu cancelled_write_bytes: %llu",
+				   &stat->rchar, &stat->wchar, &stat->syscr, &stat->syscw,
+				   &stat->read_bytes, &stat->write_bytes, &stat->cancelled_write_bytes) == 7)
+			stat->has_io = true;
+	}
+
+	BackendProcClose(&reader);
+
+	qsort(*io_stats, num_stats, sizeof(backend_io_stat), compare_backend_io_stat);
+
+	return num_stats;
+}
+
+/*
+ * I/O counters of the backends from /proc/<pid>/io: the bytes read from
+ * and written to storage, the bytes whose write was cancelled by a
+ * truncation, the bytes passed to read and write system calls, including
+ * those served by the page cache, and the number of these calls. The
+ * rates are computed against the previous call of this backend when it is
+ * recent enough, otherwise over BACKEND_SAMPLE_INTERVAL_MS, as
+ * for ReadBackendSchedulerStatistics.
+ */
+void ReadBackendIOStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum           values[Natts_backend_io];
+	bool            nulls[Natts_backend_io];
+	backend_io_stat *current_stats;
+	backend_io_stat *previous;
+	backend_io_stat zero_stat;
+	TimestampTz     current_sample_time;
+	MemoryContext   oldcontext;
+	int             num_stats;
+	int             index;
+	int             column;
+	float8          interval_ms;
+	float8          seconds;
+
+	if (BackendIOContext == NULL)
+		BackendIOContext = AllocSetContextCreate(TopMemoryContext,
+												 "system_stats backend I/O sample",
+												 ALLOCSET_DEFAULT_SIZES);
+
+	oldcontext = MemoryContextSwitchTo(BackendIOContext);
+
+	if (previous_io_stats == NULL ||
+		PreviousSampleExpired(previous_io_sample_time))
+	{
+		if (previous_io_stats != NULL)
+			pfree(previous_io_stats);
+		previous_io_stats = NULL;
+
+		previous_num_io_stats = take_backend_io_sample(&previous_io_stats, &previous_io_sample_time);
+		if (previous_num_io_stats < 0)
+		{
+			previous_io_stats = NULL;
+			MemoryContextSwitchTo(oldcontext);
+			return;
+		}
+	}
+
+	/* Wait for the part of the sampling interval that has not elapsed yet */
+	WaitSampleInterval(previous_io_sample_time, BACKEND_SAMPLE_INTERVAL_MS);
+
+	num_stats = take_backend_io_sample(&current_stats, &current_sample_time);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (num_stats < 0)
+		return;
+
+	interval_ms = (current_sample_time - previous_io_sample_time) / 1000.0;
+	seconds = interval_ms / 1000.0;
+	memset(&zero_stat, 0, sizeof(zero_stat));
+	zero_stat.has_io = true;
+
+#define BACKEND_IO_RATE(field) \
+	Float8GetDatum((current->field - Min(previous->field, current->field)) / seconds)
+
+	for (index = 0; index < num_stats; index++)
+	{
+		backend_io_stat *current = &current_stats[index];
+		backend_io_stat key;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		/* A backend started since the previous sample is charged all of its I/O */
+		key.pid = current->pid;
+		previous = (backend_io_stat *) bsearch(&key, previous_io_stats, previous_num_io_stats,
+											   sizeof(backend_io_stat), compare_backend_io_stat);
+		if (previous == NULL || previous->start_time != current->start_time)
+			previous = &zero_stat;
+
+		values[Anum_backend_io_pid] = Int32GetDatum(current->pid);
+		values[Anum_backend_io_name] = CStringGetTextDatum(current->name);
+		values[Anum_backend_io_interval_ms] = Float8GetDatum(interval_ms);
+
+		if (!current->has_io)
+		{
+			for (column = Anum_backend_io_read_bytes; column < Anum_backend_io_interval_ms; column++)
+				nulls[column] = true;
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+			continue;
+		}
+
+		values[Anum_backend_io_read_bytes] = Int64GetDatumFast((uint64) current->read_bytes);
+		values[Anum_backend_io_write_bytes] = Int64GetDatumFast((uint64) current->write_bytes);
+		values[Anum_backend_io_cancelled_write_bytes] = Int64GetDatumFast((uint64) current->cancelled_write_bytes);
+		values[Anum_backend_io_rchar] = Int64GetDatumFast((uint64) current->rchar);
+		values[Anum_backend_io_wchar] = Int64GetDatumFast((uint64) current->wchar);
+		values[Anum_backend_io_syscr] = Int64GetDatumFast((uint64) current->syscr);
+		values[Anum_backend_io_syscw] = Int64GetDatumFast((uint64) current->syscw);
+
+		if (previous->has_io && seconds > 0)
+		{
+			values[Anum_backend_io_read_bytes_per_sec] = BACKEND_IO_RATE(read_bytes);
+			values[Anum_backend_io_write_bytes_per_sec] = BACKEND_IO_RATE(write_bytes);
+			values[Anum_backend_io_cancelled_write_bytes_per_sec] = BACKEND_IO_RATE(cancelled_write_bytes);
+			values[Anum_backend_io_rchar_per_sec] = BACKEND_IO_RATE(rchar);
+			values[Anum_backend_io_wchar_per_sec] = BACKEND_IO_RATE(wchar);
+			values[Anum_backend_io_syscr_per_sec] = BACKEND_IO_RATE(syscr);
+			values[Anum_backend_io_syscw_per_sec] = BACKEND_IO_RATE(syscw);
+		}
+		else
+		{
+			for (column = Anum_backend_io_read_bytes_per_sec; column < Anum_backend_io_interval_ms; column++)
+				nulls[column] = true;
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+#undef BACKEND_IO_RATE
+
+	/* The current sample is the previous one of the next call */
+	if (previous_io_stats != NULL)
+		pfree(previous_io_stats);
+	previous_io_stats = current_stats;
+	previous_num_io_stats = num_stats;
+	previous_io_sample_time = current_sample_time;
+}
+
+/*
+ * Parse the content of /proc/<pid>/smaps_rollup, made of a header line
+ * followed by "<Field>:   <value> kB" lines. The values of the fields of
+ * smaps_rollup_field are returned in bytes; the fields the kernel does not
+ * report, such as Pss_Anon before Linux 5.13, are marked as absent.
+ * Returns false if the content has no Rss and Pss lines.
+ */
+static bool read_smaps_rollup(char *content, unsigned long long *values, bool *present)
+{
+	char               *line;
+	char               *next_line;
+	char               *colon;
+	unsigned long long value_kb;
+	int                field;
+
+	memset(present, 0, SMAPS_NUM_FIELDS * sizeof(bool));
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		colon = strchr(line, ':');
+		if (colon == NULL)
+			continue;
+		*colon = '\0';
+
+		for (field = 0; field < SMAPS_NUM_FIELDS; field++)
+		{
+			if (strcmp(line, smaps_rollup_field_names[field]) != 0)
+				continue;
+
+			if (sscanf(colon + 1, "%llu kB", &value_kb) == 1)
+			{
+				values[field] = value_kb * 1024;
+				present[field] = true;
+			}
+			break;
+		}
+	}
+
+	return present[SMAPS_RSS] && present[SMAPS_PSS];
+}
+
+/*
+ * Memory of the backends from /proc/<pid>/smaps_rollup. Unlike the
+ * resident set size, the proportional set size charges each page shared
+ * by several processes, such as the pages of shared_buffers, in equal
+ * parts to these processes, so it adds up to the memory actually used.
+ * The unique set size is the memory private to the backend, that would be
+ * freed if it exited. smaps_rollup sums the mappings in the kernel, which
+ * is much cheaper than reading /proc/<pid>/smaps. The memory columns are
+ * NULL when the file can not be read, which requires Linux 4.14.
+ */
+void ReadBackendMemoryStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum               values[Natts_backend_memory];
+	bool                nulls[Natts_backend_memory];
+	backend_proc_reader reader;
+	process_stat        *entry;
+	unsigned long long  fields[SMAPS_NUM_FIELDS];
+	bool                present[SMAPS_NUM_FIELDS];
+	int                 column;
+	char                file_name[MIN_BUFFER_SIZE];
+	char                buf[MAX_BUFFER_SIZE];
+
+	if (!BackendProcOpen(&reader))
+		return;
+
+#define SMAPS_ROLLUP_COLUMN(column, field) \
+	do { \
+		if (present[field]) \
+			values[column] = Int64GetDatumFast((uint64) fields[field]); \
+		else \
+			nulls[column] = true; \
+	} while (0)
+
+	while ((entry = BackendProcNext(&reader)) != NULL)
+	{
+		memset(nulls, 0, sizeof(nulls));
+
+		values[Anum_backend_memory_pid] = Int32GetDatum(entry->pid);
+		values[Anum_backend_memory_name] = CStringGetTextDatum(entry->name);
+
+		snprintf(file_name, MIN_BUFFER_SIZE, "%d/smaps_rollup", entry->pid);
+		if (ReadProcFileAt(reader.proc_fd, file_name, buf, sizeof(buf)) < 0 ||
+			!read_smaps_rollup(buf, fields, present))
+		{
+			for (column = Anum_backend_memory_rss_bytes; column < Natts_backend_memory; column++)
+				nulls[column] = true;
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+			continue;
+		}
+
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_rss_bytes, SMAPS_RSS);
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_pss_bytes, SMAPS_PSS);
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_pss_anon_bytes, SMAPS_PSS_ANON);
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_pss_file_bytes, SMAPS_PSS_FILE);
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_pss_shmem_bytes, SMAPS_PSS_SHMEM);
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_private_dirty_bytes, SMAPS_PRIVATE_DIRTY);
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_swap_bytes, SMAPS_SWAP);
+		SMAPS_ROLLUP_COLUMN(Anum_backend_memory_swap_pss_bytes, SMAPS_SWAP_PSS);
+
+		if (present[SMAPS_PRIVATE_CLEAN] && present[SMAPS_PRIVATE_DIRTY])
+			values[Anum_backend_memory_uss_bytes] =
+				Int64GetDatumFast((uint64) (fields[SMAPS_PRIVATE_CLEAN] + fields[SMAPS_PRIVATE_DIRTY]));
+		else
+			nulls[Anum_backend_memory_uss_bytes] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+#undef SMAPS_ROLLUP_COLUMN
+
+	BackendProcClose(&reader);
+}
@@ -0,0 +1,428 @@
+/*------------------------------------------------------------------------
+ * cgroup_info.c
+ *              Resource usage and limits of the cgroup of the server
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "utils/guc.h"
+#include "utils/timestamp.h"
+
+#include <ctype.h>
+#include <unistd.h>
+
+/* interval between two samples when there is no recent previous sample */
+#define CGROUP_SAMPLE_INTERVAL_MS     150
+
+/* report the memory of the cgroup instead of the system's, see ReadCgroupMemory */
+bool use_cgroup_limits = false;
+
+/* previous CPU usage of the cgroup read by this backend */
+static char        previous_cgroup_path[MAXPGPATH];
+static int64       previous_cgroup_usage_us = CGROUP_VALUE_UNSET;
+static TimestampTz previous_cgroup_sample_time = 0;
+
+void InitCgroupInfo(void);
+bool ReadCgroupStats(cgroup_stats *stats);
+bool ReadCgroupMemory(uint64 *total_memory, uint64 *used_memory, uint64 *cache_memory,
+					  uint64 *swap_total, uint64 *swap_used);
+void ReadCgroupInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+static char *read_cgroup_file(const char *dir, const char *file_name);
+static int64 read_cgroup_value(const char *dir, const char *file_name);
+static void read_cgroup_keyed_values(const char *dir, const char *file_name,
+									 const char *const *keys, int64 **values, int num_keys);
+static void read_cgroup_io_stat(const char *dir, cgroup_stats *stats);
+
+/* Define the GUC used to normalize the existing functions to the cgroup */
+void InitCgroupInfo(void)
+{
+	DefineCustomBoolVariable("system_stats.use_cgroup_limits",
+							 "Reports the memory of the cgroup of the server in pg_sys_memory_info.",
+							 "The total memory and swap become the limits of the cgroup, when lower "
+							 "than those of the system, and the used memory its usage.",
+							 &use_cgroup_limits,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+}
+
+/*
+ * Read given file of the cgroup directory into a palloc'd buffer, which the
+ * caller frees. The files are read once or twice per call, so they are not
+ * kept open by the file cache, where they would evict the hot files of
+ * /proc.
+ */
+static char *read_cgroup_file(const char *dir, const char *file_name)
+{
+	char path[MAXPGPATH];
+
+	snprintf(path, MAXPGPATH, "%s/%s", dir, file_name);
+
+	return ReadProcFile(path, NULL);
+}
+
+/*
+ * Read a file holding a single value, such as memory.current or
+ * memory.max. Returns CGROUP_VALUE_UNSET if the file does not exist, which
+ * is the case of the limits of the root cgroup and of the controllers not
+ * enabled for the cgroup, or if the limit is "max".
+ */
+static int64 read_cgroup_value(const char *dir, const char *file_name)
+{
+	char  *content;
+	int64 value = CGROUP_VALUE_UNSET;
+
+	content = read_cgroup_file(dir, file_name);
+	if (content == NULL)
+		return CGROUP_VALUE_UNSET;
+
+	if (isdigit((unsigned char) content[0]))
+		value = (int64) strtoull(content, NULL, 10);
+
+	pfree(content);
+
+	return value;
+}
+
+/*
+ * Read the given keys of a flat keyed file, made of "key value" lines such
+ * as cpu.stat and memory.stat. The keys that are missing are left unset.
+ */
+static void read_cgroup_keyed_values(const char *dir, const char *file_name,
+									 const char *const *keys, int64 **values, int num_keys)
+{
+	char *content;
+	char *line;
+	char *next_line;
+	char *separator;
+	int  index;
+
+	for (index = 0; index < num_keys; index++)
+		*values[index] = CGROUP_VALUE_UNSET;
+
+	content = read_cgroup_file(dir, file_name);
+	if (content == NULL)
+		return;
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		separator = strchr(line, ' ');
+		if (separator == NULL)
+			continue;
+		*separator = '\0';
+
+		for (index = 0; index < num_keys; index++)
+		{
+			if (strcmp(line, keys[index]) == 0)
+			{
+				*values[index] = (int64) strtoull(separator + 1, NULL, 10);
+				break;
+			}
+		}
+	}
+
+	pfree(content);
+}
+
+/*
+ * Sum the bytes and requests of io.stat over all the devices, from lines
+ * such as "8:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 ...".
+ */
+static void read_cgroup_io_stat(const char *dir, cgroup_stats *stats)
+{
+	char  *content;
+	char  *line;
+	char  *next_line;
+	char  *field;
+	char  *saveptr;
+	int64 value;
+
+	stats->io_read_bytes = stats->io_write_bytes = CGROUP_VALUE_UNSET;
+	stats->io_reads = stats->io_writes = CGROUP_VALUE_UNSET;
+
+	content = read_cgroup_file(dir, "io.stat");
+	if (content == NULL)
+		return;
+
+	/* A cgroup which did no I/O yet has an empty io.stat */
+	stats->io_read_bytes = stats->io_write_bytes = 0;
+	stats->io_reads = stats->io_writes = 0;
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		/* The first field is the device number */
+		if (strtok_r(line, " ", &saveptr) == NULL)
+			continue;
+
+		while ((field = strtok_r(NULL, " ", &saveptr)) != NULL)
+		{
+			if (sscanf(field, "%*[a-z]=" INT64_FORMAT, &value) != 1)
+				continue;
+
+			if (strncmp(field, "rbytes=", 7) == 0)
+				stats->io_read_bytes += value;
+			else if (strncmp(field, "wbytes=", 7) == 0)
+				stats->io_write_bytes += value;
+			else if (strncmp(field, "rios=", 5) == 0)
+				stats->io_reads += value;
+			else if (strncmp(field, "wios=", 5) == 0)
+				stats->io_writes += value;
+		}
+	}
+
+	pfree(content);
+}
+
+/*
+ * Read the usage and limits of the cgroup v2 of the server from cpu.stat,
+ * cpu.max, memory.current, memory.max, memory.stat, io.stat and the pids
+ * files. Values which are not available, or limits which are not set, are
+ * CGROUP_VALUE_UNSET. Returns false if the server runs in no cgroup v2
+ * hierarchy.
+ */
+bool ReadCgroupStats(cgroup_stats *stats)
+{
+	char *content;
+	const char *const cpu_keys[] = {
+		"usage_usec", "user_usec", "system_usec", "nr_periods", "nr_throttled", "throttled_usec"
+	};
+	int64 *cpu_values[] = {
+		&stats->cpu_usage_us, &stats->cpu_user_us, &stats->cpu_system_us,
+		&stats->cpu_periods, &stats->cpu_throttled_periods, &stats->cpu_throttled_us
+	};
+	const char *const memory_keys[] = {
+		"anon", "file", "kernel", "shmem"
+	};
+	int64 *memory_values[] = {
+		&stats->memory_anon, &stats->memory_file, &stats->memory_kernel, &stats->memory_shmem
+	};
+	const char *const memory_events_keys[] = {
+		"oom_kill"
+	};
+	int64 *memory_events_values[] = {
+		&stats->memory_oom_kills
+	};
+
+	memset(stats, 0, sizeof(cgroup_stats));
+
+	if (!GetCgroupDirectory(stats->path, MAXPGPATH))
+		return false;
+
+	/* cpu.max is "$MAX $PERIOD", where $MAX is "max" when there is no quota */
+	stats->cpu_quota_us = stats->cpu_period_us = CGROUP_VALUE_UNSET;
+	content = read_cgroup_file(stats->path, "cpu.max");
+	if (content != NULL)
+	{
+		char quota[32];
+		long long period;
+
+		if (sscanf(content, "%31s %lld", quota, &period) == 2)
+		{
+			stats->cpu_period_us = period;
+			if (strcmp(quota, "max") != 0)
+				stats->cpu_quota_us = atoll(quota);
+		}
+
+		pfree(content);
+	}
+
+	read_cgroup_keyed_values(stats->path, "cpu.stat", cpu_keys, cpu_values, lengthof(cpu_keys));
+
+	stats->memory_current = read_cgroup_value(stats->path, "memory.current");
+	stats->memory_max = read_cgroup_value(stats->path, "memory.max");
+	stats->memory_high = read_cgroup_value(stats->path, "memory.high");
+	stats->memory_swap_current = read_cgroup_value(stats->path, "memory.swap.current");
+	stats->memory_swap_max = read_cgroup_value(stats->path, "memory.swap.max");
+	read_cgroup_keyed_values(stats->path, "memory.stat", memory_keys, memory_values,
+							 lengthof(memory_keys));
+	read_cgroup_keyed_values(stats->path, "memory.events", memory_events_keys,
+							 memory_events_values, lengthof(memory_events_keys));
+
+	read_cgroup_io_stat(stats->path, stats);
+
+	stats->pids_current = read_cgroup_value(stats->path, "pids.current");
+	stats->pids_max = read_cgroup_value(stats->path, "pids.max");
+
+	return true;
+}
+
+/*
+ * When system_stats.use_cgroup_limits is on and the memory controller is
+ * enabled for the cgroup of the server, replace the memory of the system
+ * by that of the cgroup: the total becomes the limit of the cgroup when it
+ * is lower, the used memory its usage, including the page cache like the
+ * used memory of the system, and the cache its file backed memory. The
+ * swap is replaced the same way when the cgroup has a swap controller.
+ * Returns false, leaving the values untouched, otherwise.
+ */
+bool ReadCgroupMemory(uint64 *total_memory, uint64 *used_memory, uint64 *cache_memory,
+					  uint64 *swap_total, uint64 *swap_used)
+{
+	char  dir[MAXPGPATH];
+	int64 memory_current;
+	int64 memory_max;
+	int64 swap_current;
+	int64 swap_max;
+	int64 file;
+	const char *const memory_keys[] = {
+		"file"
+	};
+	int64 *memory_values[] = {
+		&file
+	};
+
+	if (!use_cgroup_limits || !GetCgroupDirectory(dir, MAXPGPATH))
+		return false;
+
+	memory_current = read_cgroup_value(dir, "memory.current");
+	if (memory_current == CGROUP_VALUE_UNSET)
+		return false;
+
+	memory_max = read_cgroup_value(dir, "memory.max");
+	if (memory_max != CGROUP_VALUE_UNSET && (uint64) memory_max < *total_memory)
+		*total_memory = memory_max;
+	*used_memory = Min((uint64) memory_current, *total_memory);
+
+	read_cgroup_keyed_values(dir, "memory.stat", memory_keys, memory_values, lengthof(memory_keys));
+	if (file != CGROUP_VALUE_UNSET)
+		*cache_memory = file;
+
+	swap_current = read_cgroup_value(dir, "memory.swap.current");
+	if (swap_current != CGROUP_VALUE_UNSET)
+	{
+		swap_max = read_cgroup_value(dir, "memory.swap.max");
+		if (swap_max != CGROUP_VALUE_UNSET && (uint64) swap_max < *swap_total)
+			*swap_total = swap_max;
+		*swap_used = Min((uint64) swap_current, *swap_total);
+	}
+
+	return true;
+}
+
+/*
+ * Report the usage and limits of the cgroup of the server as one row. The
+ * CPU usage is relative to the CPU limit of the cgroup, or to all the CPUs
+ * when it has none, and is computed against the previous call of this
+ * backend when it is recent enough, otherwise over
+ * CGROUP_SAMPLE_INTERVAL_MS.
+ */
+void ReadCgroupInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum        values[Natts_cgroup_info];
+	bool         nulls[Natts_cgroup_info];
+	cgroup_stats stats;
+	TimestampTz  sample_time;
+	float8       cpu_limit;
+
+	if (!ReadCgroupStats(&stats))
+	{
+		ereport(DEBUG1,
+				(errmsg("the server does not run in a cgroup v2 hierarchy")));
+		return;
+	}
+	sample_time = GetCurrentTimestamp();
+
+	if (stats.cpu_quota_us != CGROUP_VALUE_UNSET && stats.cpu_period_us > 0)
+		cpu_limit = (float8) stats.cpu_quota_us / stats.cpu_period_us;
+	else
+		cpu_limit = (float8) sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* Without a recent previous sample of the same cgroup, take one now */
+	if (stats.cpu_usage_us != CGROUP_VALUE_UNSET &&
+		(previous_cgroup_usage_us == CGROUP_VALUE_UNSET ||
+		 strcmp(previous_cgroup_path, stats.path) != 0 ||
+		 PreviousSampleExpired(previous_cgroup_sample_time)))
+	{
+		strlcpy(previous_cgroup_path, stats.path, MAXPGPATH);
+		previous_cgroup_usage_us = stats.cpu_usage_us;
+		previous_cgroup_sample_time = sample_time;
+
+		WaitSampleInterval(previous_cgroup_sample_time, CGROUP_SAMPLE_INTERVAL_MS);
+
+		if (!ReadCgroupStats(&stats))
+			return;
+		sample_time = GetCurrentTimestamp();
+	}
+
+	memset(nulls, 0, sizeof(nulls));
+
+	values[Anum_cgroup_path] = CStringGetTextDatum(stats.path);
+
+	if (stats.cpu_quota_us != CGROUP_VALUE_UNSET && stats.cpu_period_us > 0)
+		values[Anum_cgroup_cpu_limit] = Float8GetDatum(cpu_limit);
+	else
+		nulls[Anum_cgroup_cpu_limit] = true;
+
+	if (stats.cpu_usage_us != CGROUP_VALUE_UNSET && cpu_limit > 0 &&
+		sample_time > previous_cgroup_sample_time &&
+		stats.cpu_usage_us >= previous_cgroup_usage_us)
+	{
+		float8 interval_us = (float8) (sample_time - previous_cgroup_sample_time);
+		float8 cpu_usage = (stats.cpu_usage_us - previous_cgroup_usage_us) * 100.0 /
+			(interval_us * cpu_limit);
+
+		values[Anum_cgroup_cpu_usage] = Float8GetDatum(cpu_usage);
+	}
+	else
+		nulls[Anum_cgroup_cpu_usage] = true;
+
+	/* The current sample is the previous one of the next call */
+	if (stats.cpu_usage_us != CGROUP_VALUE_UNSET)
+	{
+		previous_cgroup_usage_us = stats.cpu_usage_us;
+		previous_cgroup_sample_time = sample_time;
+	}
+
+#define CGROUP_INT64_COLUMN(anum, value) \
+	do { \
+		if ((value) != CGROUP_VALUE_UNSET) \
+			values[(anum)] = Int64GetDatumFast(value); \
+		else \
+			nulls[(anum)] = true; \
+	} while (0)
+
+	CGROUP_INT64_COLUMN(Anum_cgroup_cpu_period_us, stats.cpu_period_us);
+	CGROUP_INT64_COLUMN(Anum_cgroup_cpu_usage_us, stats.cpu_usage_us);
+	CGROUP_INT64_COLUMN(Anum_cgroup_cpu_user_us, stats.cpu_user_us);
+	CGROUP_INT64_COLUMN(Anum_cgroup_cpu_system_us, stats.cpu_system_us);
+	CGROUP_INT64_COLUMN(Anum_cgroup_cpu_periods, stats.cpu_periods);
+	CGROUP_INT64_COLUMN(Anum_cgroup_cpu_throttled_periods, stats.cpu_throttled_periods);
+	CGROUP_INT64_COLUMN(Anum_cgroup_cpu_throttled_us, stats.cpu_throttled_us);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_current, stats.memory_current);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_max, stats.memory_max);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_high, stats.memory_high);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_swap_current, stats.memory_swap_current);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_swap_max, stats.memory_swap_max);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_anon, stats.memory_anon);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_file, stats.memory_file);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_kernel, stats.memory_kernel);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_shmem, stats.memory_shmem);
+	CGROUP_INT64_COLUMN(Anum_cgroup_memory_oom_kills, stats.memory_oom_kills);
+	CGROUP_INT64_COLUMN(Anum_cgroup_io_read_bytes, stats.io_read_bytes);
+	CGROUP_INT64_COLUMN(Anum_cgroup_io_write_bytes, stats.io_write_bytes);
+	CGROUP_INT64_COLUMN(Anum_cgroup_io_reads, stats.io_reads);
+	CGROUP_INT64_COLUMN(Anum_cgroup_io_writes, stats.io_writes);
+	CGROUP_INT64_COLUMN(Anum_cgroup_pids_current, stats.pids_current);
+	CGROUP_INT64_COLUMN(Anum_cgroup_pids_max, stats.pids_max);
+
+#undef CGROUP_INT64_COLUMN
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
@@ -10,46 +10,74 @@
 #include "postgres.h"
 #include "system_stats.h"
 
+#include "miscadmin.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
 #include <sys/types.h>
 #include <string.h>
 #include <unistd.h>
-#include <dirent.h>
-#include <ctype.h>
 #include <sys/sysinfo.h>
 
-#define READ_PROCESS_CPU_USAGE_FIRST_SAMPLE     1
-#define READ_PROCESS_CPU_USAGE_SECOND_SAMPLE    2
-
-static long long unsigned int total_cpu_usage_1 = 0;
-static long long unsigned int total_cpu_usage_2 = 0;
+/* minimum interval between the two samples of each process, in milliseconds */
+#define PROCESS_CPU_USAGE_SAMPLE_INTERVAL_MS    100
 
-/* structure used to store the data for each process */
-typedef struct node
+/* system wide values used to compute the usage of each process */
+typedef struct process_usage_context
 {
-	long long unsigned int pid;
-	long long unsigned int process_cpu_sample_1;
-	long long unsigned int process_cpu_sample_2;
+	int        no_processor;
+	int        HZ;
+	long       sys_uptime;
+	long       page_size_bytes;
+	long long unsigned int total_memory;
+} process_usage_context;
+
+/* CPU and memory usage of one process, as reported in one row */
+typedef struct process_usage
+{
+	process_stat           *entry;
+	float4                 cpu_usage;
+	float4                 user_cpu_usage;
+	float4                 system_cpu_usage;
+	float4                 memory_usage;
 	long long unsigned int rss_memory;
-	unsigned long long process_up_since_seconds;
-	char name[MAXPGPATH];
-	struct node * next;
-} node_t;
-
-node_t *head = NULL;
-node_t *prev = NULL;
-node_t *iter = NULL;
+	long long unsigned int running_since;
+} process_usage;
 
 /* Function used to get number of processor count */
 int ReadTotalProcessors(void);
 /* Function used to get total physical RAM available on system */
 uint64 ReadTotalPhysicalMemory(void);
-/* Function used to read total cpu usage for each process */
-uint64 ReadTotalCPUUsage(void);
-/* Function used to read total memory usage for each process */
-void ReadCPUMemoryUsage(int sample);
 
 void ReadCPUMemoryByProcess(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
+static bool process_name_matches(const char *name, const char *pattern);
+static bool process_matches_pattern(process_stat *entry, const char *name_pattern);
+static int compare_pids(const void *a, const void *b);
+static void WaitProcessSampleInterval(process_snapshot *first_sample);
+static void InitProcessUsageContext(process_usage_context *context);
+static void ComputeProcessUsage(process_usage_context *context, process_snapshot *first_sample,
+								process_snapshot *second_sample, process_stat *current,
+								process_usage *usage);
+static void PutProcessUsage(Tuplestorestate *tupstore, TupleDesc tupdesc, process_usage *usage);
+static void PutCPUMemoryByProcess(Tuplestorestate *tupstore, TupleDesc tupdesc,
+								  process_snapshot *first_sample, process_snapshot *second_sample,
+								  const char *name_pattern);
+static bool process_usage_lower(process_usage *left, process_usage *right, process_order order_by);
+static void top_processes_sift_down(process_usage *heap, int heap_size, int index, process_order order_by);
+static void top_processes_push(process_usage *heap, int *heap_size, int max_size,
+							   process_usage *usage, process_order order_by);
+static void top_processes_sort(process_usage *heap, int heap_size, process_order order_by);
+static void ComputeThreadUsage(process_usage_context *context, process_snapshot *first_sample,
+							   process_snapshot *second_sample, process_stat *current,
+							   process_usage *usage);
+
+
+/* previous sample of the threads of a process taken by this backend */
+static MemoryContext    ThreadSampleContext = NULL;
+static process_snapshot previous_thread_sample;
+static int              previous_thread_pid = 0;
+
 /* Read the total number of processors of the system */
 int ReadTotalProcessors()
 {
@@ -62,59 +90,19 @@ int ReadTotalProcessors()
 /* Read the total physical memory available in the system */
 uint64 ReadTotalPhysicalMemory()
 {
-	FILE       *memory_file;
-	char       *line_buf = NULL;
-	size_t     line_buf_size = 0;
-	ssize_t    line_size;
-	uint64     total_memory = 0;
-
-	/* Open the file required to read all the memory information */
-	memory_file = fopen(MEMORY_FILE_NAME, "r");
-
-	if (!memory_file)
-	{
-		char memory_file_name[MAXPGPATH];
-		snprintf(memory_file_name, MAXPGPATH, "%s", MEMORY_FILE_NAME);
-		ereport(DEBUG1,
-				(errcode_for_file_access(),
-				errmsg("can not open file %s for reading memory statistics",
-					memory_file_name)));
+	meminfo_stats stats;
+	uint64        total_memory;
+	uint64        used_memory;
+	uint64        cache_memory;
+	uint64        swap_total = 0;
+	uint64        swap_used = 0;
+
+	if (!ReadMemInfo(&stats))
 		return 0;
-	}
 
-	/* Get the first line of the file. */
-	line_size = getline(&line_buf, &line_buf_size, memory_file);
-
-	/* Loop through until we are done with the file. */
-	while (line_size >= 0)
-	{
-		/* Read the total memory of the system */
-		if (strstr(line_buf, "MemTotal") != NULL)
-		{
-			total_memory = ConvertToBytes(line_buf);
-			break;
-		}
-
-		/* Free the allocated line buffer */
-		if (line_buf != NULL)
-		{
-			free(line_buf);
-			line_buf = NULL;
-		}
-
-		/* Get the next line */
-		line_size = getline(&line_buf, &line_buf_size, memory_file);
-	}
-
-	/* Free the allocated line buffer */
-	if (line_buf != NULL)
-	{
-		free(line_buf);
-		line_buf = NULL;
-	}
-
-	/* Close the file now that we are done with it */
-	fclose(memory_file);
+	/* The memory usage of the processes is relative to the cgroup if asked to */
+	total_memory = stats.values[MEMINFO_MEM_TOTAL];
+	(void) ReadCgroupMemory(&total_memory, &used_memory, &cache_memory, &swap_total, &swap_used);
 
 	return total_memory;
 }
@@ -122,10 +110,8 @@ uint64 ReadTotalPhysicalMemory()
 /* Read the total CPU usage */
 uint64 ReadTotalCPUUsage()
 {
-	FILE       *cpu_stats_file;
-	char       *line_buf = NULL;
-	size_t     line_buf_size = 0;
-	ssize_t    line_size;
+	char       *content;
+	char       *cpu_line;
 	char       cpu_name[MAXPGPATH];
 	uint64     total_cpu_time = 0;
 	uint64     usermode_normal_process = 0;
@@ -137,9 +123,10 @@ uint64 ReadTotalCPUUsage()
 
 	memset(cpu_name, 0, MAXPGPATH);
 
-	cpu_stats_file = fopen(CPU_USAGE_STATS_FILENAME, "r");
+	/* The aggregate cpu line comes first in the file */
+	content = ReadCachedProcFile(CPU_USAGE_STATS_FILENAME, NULL);
 
-	if (!cpu_stats_file)
+	if (content == NULL)
 	{
 		char cpu_stats_file_name[MAXPGPATH];
 		snprintf(cpu_stats_file_name, MAXPGPATH, "%s", CPU_USAGE_STATS_FILENAME);
@@ -151,225 +138,637 @@ uint64 ReadTotalCPUUsage()
 		return 0;
 	}
 
-	/* Get the first line of the file. */
-	line_size = getline(&line_buf, &line_buf_size, cpu_stats_file);
+	cpu_line = strstr(content, "cpu");
+	if (cpu_line != NULL)
+	{
+		sscanf(cpu_line, scan_fmt, cpu_name,
+					&usermode_normal_process,
+					&usermode_niced_process,
+					&kernelmode_process,
+					&idle_mode,
+					&io_completion);
+		total_cpu_time = usermode_normal_process + usermode_niced_process + kernelmode_process + idle_mode + io_completion;
+	}
 
-	/* Loop through until we are done with the file. */
-	while (line_size >= 0)
+	return total_cpu_time;
+}
+
+/*
+ * Match a process name against a LIKE pattern, where % matches any sequence
+ * of characters, _ matches any single character and a backslash escapes the
+ * next character.
+ */
+static bool process_name_matches(const char *name, const char *pattern)
+{
+	while (*pattern != '\0')
 	{
-		if (strstr(line_buf, "cpu") != NULL)
+		if (*pattern == '%')
 		{
-			sscanf(line_buf, scan_fmt, cpu_name,
-						&usermode_normal_process,
-						&usermode_niced_process,
-						&kernelmode_process,
-						&idle_mode,
-						&io_completion);
-			total_cpu_time = usermode_normal_process + usermode_niced_process + kernelmode_process + idle_mode + io_completion;
-			break;
+			while (*pattern == '%')
+				pattern++;
+			if (*pattern == '\0')
+				return true;
+
+			for (; *name != '\0'; name++)
+			{
+				if (process_name_matches(name, pattern))
+					return true;
+			}
+			return false;
 		}
 
-		/* Free the allocated line buffer */
-		if (line_buf != NULL)
+		if (*pattern == '_')
+		{
+			if (*name == '\0')
+				return false;
+		}
+		else
 		{
-			free(line_buf);
-			line_buf = NULL;
+			if (*pattern == '\\' && pattern[1] != '\0')
+				pattern++;
+			if (*name != *pattern)
+				return false;
 		}
 
-		/* Get the next line */
-		line_size = getline(&line_buf, &line_buf_size, cpu_stats_file);
+		name++;
+		pattern++;
 	}
 
-	/* Free the allocated line buffer */
-	if (line_buf != NULL)
-	{
-		free(line_buf);
-		line_buf = NULL;
-	}
+	return *name == '\0';
+}
 
-	fclose(cpu_stats_file);
+/* Match the name of the process, without the parentheses around it */
+static bool process_matches_pattern(process_stat *entry, const char *name_pattern)
+{
+	char name[PROCESS_NAME_LEN];
+	int  name_len;
 
-	return total_cpu_time;
+	strlcpy(name, entry->name[0] == '(' ? entry->name + 1 : entry->name, PROCESS_NAME_LEN);
+
+	name_len = strlen(name);
+	if (name_len > 0 && name[name_len - 1] == ')')
+		name[name_len - 1] = '\0';
+
+	return process_name_matches(name, name_pattern);
+}
+
+static int compare_pids(const void *a, const void *b)
+{
+	int left = *(const int *) a;
+	int right = *(const int *) b;
+
+	return (left > right) - (left < right);
+}
+
+/*
+ * Wait for the part of the sampling interval that has not already elapsed
+ * since the first sample was taken.
+ */
+static void WaitProcessSampleInterval(process_snapshot *first_sample)
+{
+	WaitSampleInterval(first_sample->snapshot_time, PROCESS_CPU_USAGE_SAMPLE_INTERVAL_MS);
 }
 
-/* Read CPU and memory informations all processes and store in
- * linked list for further processing */
-void ReadCPUMemoryUsage(int sample)
+/* Read the system wide values needed to compute the usage of each process */
+static void InitProcessUsageContext(process_usage_context *context)
 {
-	FILE *fpstat;
-	struct dirent *ent, dbuf;
-	char  file_name[MAXPGPATH];
-	long utime_ticks, stime_ticks;
-	char process_name[MAXPGPATH] = {0};
-	int pid = 0;
-	long unsigned int mem_rss = 0;
-	unsigned  long long  process_up_since = 0;
-	int        HZ = 100;
 	long       tlk = -1;
 	struct     sysinfo s_info;
-	long       sys_uptime = 0;
-	DIR        *dirp = NULL;
+
+	context->HZ = 100;
+	context->sys_uptime = 0;
 
 	/* First get the HZ value from system as it may vary from system to system */
 	tlk = sysconf(_SC_CLK_TCK);
 
 	if (tlk != -1 && tlk > 0)
-	    HZ = (int)tlk;
+	    context->HZ = (int)tlk;
 
 	if (sysinfo(&s_info) == 0)
-		sys_uptime = s_info.uptime;
+		context->sys_uptime = s_info.uptime;
+
+	context->no_processor =  ReadTotalProcessors();
+	context->total_memory = ReadTotalPhysicalMemory();
+	context->page_size_bytes = sysconf(_SC_PAGESIZE);
+}
+
+/* Compute the CPU and memory usage of one process of the first sample */
+static void ComputeProcessUsage(process_usage_context *context, process_snapshot *first_sample,
+								process_snapshot *second_sample, process_stat *current,
+								process_usage *usage)
+{
+	process_stat           *second;
+	long long unsigned int process_cpu_sample_2;
+
+	/* A process that exits before the second sample reports no usage */
+	second = LookupProcessSnapshot(second_sample, current->pid, current->start_time);
+	process_cpu_sample_2 = (second != NULL) ? second->cpu_ticks : current->cpu_ticks;
+
+	usage->entry = current;
+	usage->cpu_usage = (context->no_processor) * (process_cpu_sample_2 - current->cpu_ticks) * 100 / (float) (second_sample->total_cpu_ticks - first_sample->total_cpu_ticks);
+	usage->rss_memory = current->rss_pages * context->page_size_bytes;
+	usage->memory_usage = (usage->rss_memory/(float)context->total_memory)*100;
+	usage->running_since = (unsigned long long)((unsigned long long)context->sys_uptime - (current->start_time/context->HZ));
+	usage->memory_usage = fl_round(usage->memory_usage);
+	usage->cpu_usage = fl_round(usage->cpu_usage);
+}
 
-	dirp = opendir(PROC_FILE_SYSTEM_PATH);
+static void PutProcessUsage(Tuplestorestate *tupstore, TupleDesc tupdesc, process_usage *usage)
+{
+	Datum      values[Natts_cpu_memory_info_by_process];
+	bool       nulls[Natts_cpu_memory_info_by_process];
+	char       command[MAXPGPATH];
 
-	if (!dirp)
+	memset(nulls, 0, sizeof(nulls));
+	memset(command, 0, MAXPGPATH);
+	memcpy(command, usage->entry->name, PROCESS_NAME_LEN);
+
+	values[Anum_process_pid] = Int32GetDatum(usage->entry->pid);
+	values[Anum_process_name] = CStringGetTextDatum(command);
+	values[Anum_percent_cpu_usage] = Float4GetDatum(usage->cpu_usage);
+	values[Anum_percent_memory_usage] = Float4GetDatum(usage->memory_usage);
+	values[Anum_process_memory_bytes] = Int64GetDatumFast((uint64)usage->rss_memory);
+	values[Anum_process_running_since] = Int64GetDatumFast((uint64)(usage->running_since));
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
+
+/*
+ * Put one row per process of the first sample, or only per process whose
+ * name matches name_pattern if it is not NULL.
+ */
+static void PutCPUMemoryByProcess(Tuplestorestate *tupstore, TupleDesc tupdesc,
+								  process_snapshot *first_sample, process_snapshot *second_sample,
+								  const char *name_pattern)
+{
+	process_usage_context context;
+	process_usage         usage;
+	int                   index;
+
+	InitProcessUsageContext(&context);
+
+	// Process the CPU and memory information of each process in the order it was read */
+	for (index = 0; index < first_sample->num_entries; index++)
 	{
-		ereport(DEBUG1, (errmsg("Error opening /proc directory")));
+		process_stat *current = &first_sample->entries[index];
+
+		if (name_pattern != NULL && !process_matches_pattern(current, name_pattern))
+			continue;
+
+		ComputeProcessUsage(&context, first_sample, second_sample, current, &usage);
+		PutProcessUsage(tupstore, tupdesc, &usage);
+	}
+}
+
+void ReadCPUMemoryByProcess(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	process_snapshot *first_sample;
+	process_snapshot second_sample;
+
+	/*
+	 * Read the first sample for cpu and memory usage by each process. It is
+	 * shared with the other process based functions of this statement, so
+	 * only wait for the part of the sampling interval that has not already
+	 * elapsed since it was taken.
+	 */
+	first_sample = GetStatementProcessSnapshot();
+	if (first_sample == NULL)
+		return;
+
+	WaitProcessSampleInterval(first_sample);
+
+	/* Read the second sample for cpu usage by each process */
+	if (!TakeProcessSnapshot(&second_sample))
 		return;
+
+	PutCPUMemoryByProcess(tupstore, tupdesc, first_sample, &second_sample, NULL);
+
+	FreeProcessSnapshot(&second_sample);
+}
+
+/*
+ * CPU and memory usage of the given processes only. Both samples read
+ * /proc/<pid>/stat of these processes directly, so the cost depends on the
+ * number of pids and not on the number of processes of the system.
+ */
+void ReadCPUMemoryByProcessPids(Tuplestorestate *tupstore, TupleDesc tupdesc, int *pids, int num_pids)
+{
+	process_snapshot first_sample;
+	process_snapshot second_sample;
+	int              num_unique = 0;
+	int              index;
+
+	if (num_pids == 0)
+		return;
+
+	/* Report each process once, even if given several times */
+	qsort(pids, num_pids, sizeof(int), compare_pids);
+	for (index = 0; index < num_pids; index++)
+	{
+		if (num_unique == 0 || pids[num_unique - 1] != pids[index])
+			pids[num_unique++] = pids[index];
 	}
 
-	while (readdir_r(dirp, &dbuf, &ent) == 0)
+	if (!TakeProcessSnapshotOfPids(&first_sample, pids, num_unique))
+		return;
+
+	if (first_sample.num_entries > 0)
 	{
-		memset(file_name, 0x00, MAXPGPATH);
+		WaitProcessSampleInterval(&first_sample);
+
+		if (TakeProcessSnapshotOfPids(&second_sample, pids, num_unique))
+		{
+			PutCPUMemoryByProcess(tupstore, tupdesc, &first_sample, &second_sample, NULL);
+			FreeProcessSnapshot(&second_sample);
+		}
+	}
 
-		if (!ent)
-			break;
+	FreeProcessSnapshot(&first_sample);
+}
 
-		if (!isdigit(*ent->d_name))
-			continue;
+/*
+ * CPU and memory usage of the processes whose name matches given LIKE
+ * pattern. The names come from the process snapshot of the statement, and
+ * only the matching processes are read again for the second sample.
+ */
+void ReadCPUMemoryByProcessName(Tuplestorestate *tupstore, TupleDesc tupdesc, const char *name_pattern)
+{
+	process_snapshot *first_sample;
+	process_snapshot second_sample;
+	int              *pids;
+	int              num_pids = 0;
+	int              index;
+
+	first_sample = GetStatementProcessSnapshot();
+	if (first_sample == NULL)
+		return;
 
-		sprintf(file_name,"/proc/%s/stat", ent->d_name);
+	pids = (int *) palloc(Max(first_sample->num_entries, 1) * sizeof(int));
+	for (index = 0; index < first_sample->num_entries; index++)
+	{
+		if (process_matches_pattern(&first_sample->entries[index], name_pattern))
+			pids[num_pids++] = first_sample->entries[index].pid;
+	}
 
-		fpstat = fopen(file_name, "r");
-		if (fpstat == NULL)
-			continue;
+	if (num_pids > 0)
+	{
+		WaitProcessSampleInterval(first_sample);
 
-		if (fscanf(fpstat, "%d %s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu"
-					"%lu %*d %*d %*d %*d %*d %*d %llu %*u %ld",
-					&pid, process_name, &utime_ticks, &stime_ticks, &process_up_since, &mem_rss) == EOF)
+		if (TakeProcessSnapshotOfPids(&second_sample, pids, num_pids))
 		{
-			ereport(DEBUG1,
-				(errmsg("Error in parsing file '/proc/%d/stat'", pid)));
-			fclose(fpstat);
-			continue;
+			PutCPUMemoryByProcess(tupstore, tupdesc, first_sample, &second_sample, name_pattern);
+			FreeProcessSnapshot(&second_sample);
 		}
+	}
 
-		if (sample == READ_PROCESS_CPU_USAGE_FIRST_SAMPLE)
+	pfree(pids);
+}
+
+/* Whether left comes after right in the order of pg_sys_top_processes */
+static bool process_usage_lower(process_usage *left, process_usage *right, process_order order_by)
+{
+	if (order_by == PROCESS_ORDER_MEMORY)
+	{
+		if (left->rss_memory != right->rss_memory)
+			return left->rss_memory < right->rss_memory;
+	}
+	else if (left->cpu_usage != right->cpu_usage)
+		return left->cpu_usage < right->cpu_usage;
+
+	/* keep the result stable between calls for equal usage */
+	return left->entry->pid > right->entry->pid;
+}
+
+/* Restore the min heap property below given index */
+static void top_processes_sift_down(process_usage *heap, int heap_size, int index, process_order order_by)
+{
+	for (;;)
+	{
+		int           lowest = index;
+		int           left = 2 * index + 1;
+		int           right = left + 1;
+		process_usage swap;
+
+		if (left < heap_size && process_usage_lower(&heap[left], &heap[lowest], order_by))
+			lowest = left;
+		if (right < heap_size && process_usage_lower(&heap[right], &heap[lowest], order_by))
+			lowest = right;
+
+		if (lowest == index)
+			return;
+
+		swap = heap[index];
+		heap[index] = heap[lowest];
+		heap[lowest] = swap;
+		index = lowest;
+	}
+}
+
+/*
+ * Add given usage to the min heap of the max_size entries using the most CPU
+ * or memory seen so far, replacing the lowest entry once the heap is full.
+ */
+static void top_processes_push(process_usage *heap, int *heap_size, int max_size,
+							   process_usage *usage, process_order order_by)
+{
+	if (*heap_size < max_size)
+	{
+		int child = (*heap_size)++;
+
+		/* sift the new entry up to its place */
+		heap[child] = *usage;
+		while (child > 0 && process_usage_lower(&heap[child], &heap[(child - 1) / 2], order_by))
 		{
-			iter = (node_t *) malloc(sizeof(node_t));
-			if (iter == NULL)
-			{
-				fclose(fpstat);
-				continue;
-			}
+			process_usage swap = heap[child];
 
-			iter->pid = pid;
-			memcpy(iter->name, process_name, MAXPGPATH);
-			iter->process_cpu_sample_1 = utime_ticks + stime_ticks;
-			iter->rss_memory = mem_rss;
-			process_up_since = (unsigned long long)((unsigned long long)sys_uptime - (process_up_since/HZ));
-			iter->process_up_since_seconds = process_up_since;
-			iter->next = NULL;
-			if (head == NULL)
-				head = iter;
-			else
-				prev->next = iter;
-			prev = iter;
+			heap[child] = heap[(child - 1) / 2];
+			heap[(child - 1) / 2] = swap;
+			child = (child - 1) / 2;
 		}
-		else
+	}
+	else if (max_size > 0 && process_usage_lower(&heap[0], usage, order_by))
+	{
+		heap[0] = *usage;
+		top_processes_sift_down(heap, *heap_size, 0, order_by);
+	}
+}
+
+/* Sort the heap in decreasing order, moving the lowest entry to the end */
+static void top_processes_sort(process_usage *heap, int heap_size, process_order order_by)
+{
+	process_usage swap;
+	int           index;
+
+	for (index = heap_size - 1; index > 0; index--)
+	{
+		swap = heap[0];
+		heap[0] = heap[index];
+		heap[index] = swap;
+		top_processes_sift_down(heap, index, 0, order_by);
+	}
+}
+
+/*
+ * The num_processes processes using the most CPU or memory, in decreasing
+ * order. A min heap of num_processes entries holds the top processes seen
+ * so far while the snapshot is scanned, so only the returned rows are
+ * formed, instead of one row per process sorted by the executor.
+ */
+void ReadTopProcesses(Tuplestorestate *tupstore, TupleDesc tupdesc, int num_processes, process_order order_by)
+{
+	process_snapshot      *first_sample;
+	process_snapshot      second_sample;
+	process_usage_context context;
+	process_usage         usage;
+	process_usage         *heap;
+	int                   heap_size = 0;
+	int                   index;
+
+	if (num_processes <= 0)
+		return;
+
+	first_sample = GetStatementProcessSnapshot();
+	if (first_sample == NULL)
+		return;
+
+	WaitProcessSampleInterval(first_sample);
+
+	if (!TakeProcessSnapshot(&second_sample))
+		return;
+
+	InitProcessUsageContext(&context);
+
+	num_processes = Min(num_processes, first_sample->num_entries);
+	heap = (process_usage *) palloc(Max(num_processes, 1) * sizeof(process_usage));
+
+	for (index = 0; index < first_sample->num_entries; index++)
+	{
+		ComputeProcessUsage(&context, first_sample, &second_sample,
+							&first_sample->entries[index], &usage);
+		top_processes_push(heap, &heap_size, num_processes, &usage, order_by);
+	}
+
+	top_processes_sort(heap, heap_size, order_by);
+
+	for (index = 0; index < heap_size; index++)
+		PutProcessUsage(tupstore, tupdesc, &heap[index]);
+
+	pfree(heap);
+	FreeProcessSnapshot(&second_sample);
+}
+
+/*
+ * CPU and memory usage, page faults and state of the backends and other
+ * children of the postmaster, see ReadBackendPids.
+ */
+void ReadBackendResourceUsage(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum                 values[Natts_backend_resource_usage];
+	bool                  nulls[Natts_backend_resource_usage];
+	process_snapshot      first_sample;
+	process_snapshot      second_sample;
+	process_usage_context context;
+	process_usage         usage;
+	int                   *pids;
+	int                   num_pids = 0;
+	int                   index;
+	char                  state[2];
+
+	memset(nulls, 0, sizeof(nulls));
+
+	pids = ReadBackendPids(&num_pids);
+	if (pids == NULL)
+		return;
+
+	if (num_pids == 0 || !TakeProcessSnapshotOfPids(&first_sample, pids, num_pids))
+	{
+		pfree(pids);
+		return;
+	}
+
+	WaitProcessSampleInterval(&first_sample);
+
+	if (TakeProcessSnapshotOfPids(&second_sample, pids, num_pids))
+	{
+		InitProcessUsageContext(&context);
+
+		for (index = 0; index < first_sample.num_entries; index++)
 		{
-			node_t * current = head;
-			while (current != NULL)
-			{
-				if (current->pid == atoi(ent->d_name))
-				{
-					current->process_cpu_sample_2 = utime_ticks + stime_ticks;
-					break;
-				}
-				else
-					current = current->next;
-			}
+			process_stat *current = &first_sample.entries[index];
+			process_stat *second = LookupProcessSnapshot(&second_sample, current->pid, current->start_time);
+
+			/* The pid may have been reused by a process outside the cluster */
+			if (current->ppid != PostmasterPid)
+				continue;
+
+			ComputeProcessUsage(&context, &first_sample, &second_sample, current, &usage);
+
+			/* Report the latest state and page fault counters */
+			if (second != NULL)
+				current = second;
+
+			state[0] = current->state;
+			state[1] = '\0';
+
+			values[Anum_backend_pid] = Int32GetDatum(current->pid);
+			values[Anum_backend_name] = CStringGetTextDatum(current->name);
+			values[Anum_backend_state] = CStringGetTextDatum(state);
+			values[Anum_backend_cpu_usage] = Float4GetDatum(usage.cpu_usage);
+			values[Anum_backend_memory_usage] = Float4GetDatum(usage.memory_usage);
+			values[Anum_backend_memory_bytes] = Int64GetDatumFast((uint64) usage.rss_memory);
+			values[Anum_backend_minor_faults] = Int64GetDatumFast((uint64) current->minor_faults);
+			values[Anum_backend_major_faults] = Int64GetDatumFast((uint64) current->major_faults);
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 		}
 
-		fclose(fpstat);
-		fpstat = NULL;
+		FreeProcessSnapshot(&second_sample);
 	}
 
-	closedir(dirp);
+	FreeProcessSnapshot(&first_sample);
+	pfree(pids);
 }
 
-void ReadCPUMemoryByProcess(Tuplestorestate *tupstore, TupleDesc tupdesc)
+/*
+ * Compute the CPU usage of one thread of the second sample. A thread
+ * missing from the first sample started since, so all of its CPU time was
+ * spent during the interval.
+ */
+static void ComputeThreadUsage(process_usage_context *context, process_snapshot *first_sample,
+							   process_snapshot *second_sample, process_stat *current,
+							   process_usage *usage)
 {
-	Datum      values[Natts_cpu_memory_info_by_process];
-	bool       nulls[Natts_cpu_memory_info_by_process];
-	char       command[MAXPGPATH];
-	int        process_pid = 0;
-	int        no_processor = 0;
-	float4     cpu_usage = 0.0;
-	float4     memory_usage = 0.0;
-	long page_size_bytes = 0;
-	long long unsigned int     total_memory;
-	long long unsigned int     rss_memory;
-	long long unsigned int     running_since;
-	node_t *del_iter = NULL;
-	node_t *current  = NULL;
+	process_stat           *first;
+	long long unsigned int user_ticks = current->utime_ticks;
+	long long unsigned int system_ticks = current->stime_ticks;
+	float                  total_ticks;
 
-	memset(nulls, 0, sizeof(nulls));
-	memset(command, 0, MAXPGPATH);
+	first = LookupProcessSnapshot(first_sample, current->pid, current->start_time);
+	if (first != NULL)
+	{
+		user_ticks -= Min(first->utime_ticks, user_ticks);
+		system_ticks -= Min(first->stime_ticks, system_ticks);
+	}
 
-	no_processor =  ReadTotalProcessors();
-	total_memory = ReadTotalPhysicalMemory();
-	total_cpu_usage_1 = ReadTotalCPUUsage();
-	/* Read the first sample for cpu and memory usage by each process */
-	ReadCPUMemoryUsage(READ_PROCESS_CPU_USAGE_FIRST_SAMPLE);
-	usleep(100000);
-	/* Read the second sample for cpu and memory usage by each process */
-	total_cpu_usage_2 = ReadTotalCPUUsage();
-	ReadCPUMemoryUsage(READ_PROCESS_CPU_USAGE_SECOND_SAMPLE);
+	total_ticks = (float) (second_sample->total_cpu_ticks - first_sample->total_cpu_ticks);
 
-	page_size_bytes = sysconf(_SC_PAGESIZE);
+	usage->entry = current;
+	usage->user_cpu_usage = 0;
+	usage->system_cpu_usage = 0;
+	if (total_ticks > 0)
+	{
+		usage->user_cpu_usage = fl_round(context->no_processor * user_ticks * 100 / total_ticks);
+		usage->system_cpu_usage = fl_round(context->no_processor * system_ticks * 100 / total_ticks);
+	}
+	usage->cpu_usage = fl_round(usage->user_cpu_usage + usage->system_cpu_usage);
+	usage->rss_memory = 0;
+	usage->memory_usage = 0;
+	usage->running_since = (unsigned long long)((unsigned long long)context->sys_uptime - (current->start_time/context->HZ));
+}
 
-	// Iterate through head and read all the informations */
-	current = head;
+/*
+ * The num_threads threads of given process using the most CPU, in
+ * decreasing order, read from /proc/<pid>/task. The CPU usage is computed
+ * against the previous call of this backend for the same process when it
+ * is recent enough, so a session polling a process with a large thread
+ * pool costs one pass over its threads per call. The two samples are
+ * always at least PROCESS_CPU_USAGE_SAMPLE_INTERVAL_MS apart, so calls in
+ * a row do not compute the usage over a few milliseconds. Only the
+ * returned rows are formed, using the same heap as pg_sys_top_processes.
+ */
+void ReadThreadStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc, int pid, int num_threads)
+{
+	Datum                 values[Natts_thread_stats];
+	bool                  nulls[Natts_thread_stats];
+	char                  state[2];
+	process_snapshot      current_sample;
+	process_usage_context context;
+	process_usage         usage;
+	process_usage         *heap;
+	int                   heap_size = 0;
+	int                   index;
+	MemoryContext         oldcontext;
+
+	if (num_threads <= 0)
+		return;
 
-	// Process the CPU and memory information from linked list and free it once processed */
-	while (current != NULL)
+	if (ThreadSampleContext == NULL)
 	{
-		process_pid = current->pid;
-		memcpy(command, current->name, MAXPGPATH);
-		cpu_usage = (no_processor) * (current->process_cpu_sample_2 - current->process_cpu_sample_1) * 100 / (float) (total_cpu_usage_2 - total_cpu_usage_1);
-		rss_memory = current->rss_memory * page_size_bytes;
-		memory_usage = (rss_memory/(float)total_memory)*100;
-		running_since = current->process_up_since_seconds;
-		memory_usage = fl_round(memory_usage);
-		cpu_usage = fl_round(cpu_usage);
-
-		values[Anum_process_pid] = Int32GetDatum(process_pid);
-		values[Anum_process_name] = CStringGetTextDatum(command);
-		values[Anum_percent_cpu_usage] = Float4GetDatum(cpu_usage);
-		values[Anum_percent_memory_usage] = Float4GetDatum(memory_usage);
-		values[Anum_process_memory_bytes] = Int64GetDatumFast((uint64)rss_memory);
-		values[Anum_process_running_since] = Int64GetDatumFast((uint64)(running_since));
+		ThreadSampleContext = AllocSetContextCreate(TopMemoryContext,
+													"system_stats thread sample",
+													ALLOCSET_DEFAULT_SIZES);
+		memset(&previous_thread_sample, 0, sizeof(process_snapshot));
+	}
 
-		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	oldcontext = MemoryContextSwitchTo(ThreadSampleContext);
 
-		//reset the value again
-		memset(command, 0, MAXPGPATH);
-		process_pid = 0;
-		cpu_usage = 0.0;
-		memory_usage = 0.0;
-		running_since = 0;
-		rss_memory = 0;
-
-		del_iter = current;
-		current = current->next;
-		if (del_iter != NULL)
+	/* Without a recent previous sample of the same process, take one now */
+	if (previous_thread_pid != pid || previous_thread_sample.entries == NULL ||
+		PreviousSampleExpired(previous_thread_sample.snapshot_time))
+	{
+		FreeProcessSnapshot(&previous_thread_sample);
+		previous_thread_pid = 0;
+
+		if (!TakeThreadSnapshot(&previous_thread_sample, pid))
 		{
-			free(del_iter);
-			del_iter = NULL;
+			MemoryContextSwitchTo(oldcontext);
+			return;
 		}
+		previous_thread_pid = pid;
+	}
+
+	/* Wait for the part of the sampling interval that has not elapsed yet */
+	WaitProcessSampleInterval(&previous_thread_sample);
+
+	if (!TakeThreadSnapshot(&current_sample, pid))
+	{
+		FreeProcessSnapshot(&previous_thread_sample);
+		previous_thread_pid = 0;
+		MemoryContextSwitchTo(oldcontext);
+		return;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	InitProcessUsageContext(&context);
+
+	num_threads = Min(num_threads, current_sample.num_entries);
+	heap = (process_usage *) palloc(Max(num_threads, 1) * sizeof(process_usage));
+
+	for (index = 0; index < current_sample.num_entries; index++)
+	{
+		ComputeThreadUsage(&context, &previous_thread_sample, &current_sample,
+						   &current_sample.entries[index], &usage);
+		top_processes_push(heap, &heap_size, num_threads, &usage, PROCESS_ORDER_CPU);
+	}
+
+	top_processes_sort(heap, heap_size, PROCESS_ORDER_CPU);
+
+	memset(nulls, 0, sizeof(nulls));
+
+	for (index = 0; index < heap_size; index++)
+	{
+		process_stat *entry = heap[index].entry;
+
+		state[0] = entry->state;
+		state[1] = '\0';
+
+		values[Anum_thread_tid] = Int32GetDatum(entry->pid);
+		values[Anum_thread_name] = CStringGetTextDatum(entry->name);
+		values[Anum_thread_state] = CStringGetTextDatum(state);
+		values[Anum_thread_cpu_usage] = Float4GetDatum(heap[index].cpu_usage);
+		values[Anum_thread_user_cpu_usage] = Float4GetDatum(heap[index].user_cpu_usage);
+		values[Anum_thread_system_cpu_usage] = Float4GetDatum(heap[index].system_cpu_usage);
+		values[Anum_thread_minor_faults] = Int64GetDatumFast((uint64) entry->minor_faults);
+		values[Anum_thread_major_faults] = Int64GetDatumFast((uint64) entry->major_faults);
+		values[Anum_thread_running_since] = Int64GetDatumFast((uint64) heap[index].running_since);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 	}
 
-	head = NULL;
-	prev = NULL;
-	iter = NULL;
+	pfree(heap);
+
+	/* The current sample is the previous one of the next call */
+	FreeProcessSnapshot(&previous_thread_sample);
+	previous_thread_sample = current_sample;
 }
@@ -10,29 +10,30 @@
 #include "postgres.h"
 #include "system_stats.h"
 
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include <ctype.h>
 #include <unistd.h>
 
+/* interval between two samples when there is no recent previous sample */
+#define CPU_CORE_SAMPLE_INTERVAL_MS     150
+
+/* previous per CPU sample of this backend, see ReadCPUUsagePerCore */
+static MemoryContext CPUCoreSampleContext = NULL;
+static cpu_core_stat *previous_core_stats = NULL;
+static int           previous_num_cores = 0;
+static TimestampTz   previous_core_sample_time = 0;
+
 void ReadCPUUsageStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
-struct cpu_stat
-{
-	long long int usermode_normal_process;
-	long long int usermode_niced_process;
-	long long int kernelmode_process;
-	long long int idle_mode;
-	long long int io_completion;
-	long long int servicing_irq;
-	long long int servicing_softirq;
-};
-
-void cpu_stat_information(struct cpu_stat* cpu_stat);
+static int take_cpu_core_sample(cpu_core_stat **core_stats);
+
 /* Function used to get CPU state information for each mode of operation */
 void cpu_stat_information(struct cpu_stat* cpu_stat)
 {
-	FILE              *cpu_stats_file;
-	char              *line_buf = NULL;
-	size_t            line_buf_size = 0;
-	ssize_t           line_size;
+	char              *content;
+	char              *cpu_line;
 	long long int     usermode_normal_process = 0;
 	long long int     usermode_niced_process = 0;
 	long long int     kernelmode_process = 0;
@@ -40,11 +41,16 @@ void cpu_stat_information(struct cpu_stat* cpu_stat)
 	long long int     io_completion = 0;
 	long long int     servicing_irq = 0;
 	long long int     servicing_softirq = 0;
-	const char *scan_fmt = "%*s %llu %llu %llu %llu %llu %llu %llu";
+	long long int     steal_time = 0;
+	long long int     guest_mode = 0;
+	long long int     guest_niced_mode = 0;
+	const char *scan_fmt = "%*s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu";
 
-	cpu_stats_file = fopen(CPU_USAGE_STATS_FILENAME, "r");
+	/* The aggregate cpu line comes first in the file */
+	content = ReadCachedProcFile(CPU_USAGE_STATS_FILENAME, NULL);
+	cpu_line = (content != NULL) ? strstr(content, "cpu") : NULL;
 
-	if (!cpu_stats_file)
+	if (cpu_line == NULL)
 	{
 		char cpu_stats_file_name[MAXPGPATH];
 		snprintf(cpu_stats_file_name, MAXPGPATH, "%s", CPU_USAGE_STATS_FILENAME);
@@ -61,54 +67,33 @@ void cpu_stat_information(struct cpu_stat* cpu_stat)
 		cpu_stat->io_completion = 0;
 		cpu_stat->servicing_irq = 0;
 		cpu_stat->servicing_softirq = 0;
+		cpu_stat->steal_time = 0;
+		cpu_stat->guest_mode = 0;
+		cpu_stat->guest_niced_mode = 0;
 		return;
 	}
 
-	/* Get the first line of the file. */
-	line_size = getline(&line_buf, &line_buf_size, cpu_stats_file);
-
-	/* Loop through until we are done with the file. */
-	while (line_size >= 0)
-	{
-		if (strstr(line_buf, "cpu") != NULL)
-		{
-			sscanf(line_buf, scan_fmt, &usermode_normal_process,
-						&usermode_niced_process,
-						&kernelmode_process,
-						&idle_mode,
-						&io_completion,
-						&servicing_irq,
-						&servicing_softirq);
-
-			cpu_stat->usermode_normal_process = usermode_normal_process;
-			cpu_stat->usermode_niced_process = usermode_niced_process;
-			cpu_stat->kernelmode_process = kernelmode_process;
-			cpu_stat->idle_mode = idle_mode;
-			cpu_stat->io_completion = io_completion;
-			cpu_stat->servicing_irq = servicing_irq;
-			cpu_stat->servicing_softirq = servicing_softirq;
-			break;
-		}
-
-		/* Free the allocated line buffer */
-		if (line_buf != NULL)
-		{
-			free(line_buf);
-			line_buf = NULL;
-		}
-
-		/* Get the next line */
-		line_size = getline(&line_buf, &line_buf_size, cpu_stats_file);
-	}
-
-	/* Free the allocated line buffer */
-	if (line_buf != NULL)
-	{
-		free(line_buf);
-		line_buf = NULL;
-	}
+	sscanf(cpu_line, scan_fmt, &usermode_normal_process,
+				&usermode_niced_process,
+				&kernelmode_process,
+				&idle_mode,
+				&io_completion,
+				&servicing_irq,
+				&servicing_softirq,
+				&steal_time,
+				&guest_mode,
+				&guest_niced_mode);
 
-	fclose(cpu_stats_file);
+	cpu_stat->usermode_normal_process = usermode_normal_process;
+	cpu_stat->usermode_niced_process = usermode_niced_process;
+	cpu_stat->kernelmode_process = kernelmode_process;
+	cpu_stat->idle_mode = idle_mode;
+	cpu_stat->io_completion = io_completion;
+	cpu_stat->servicing_irq = servicing_irq;
+	cpu_stat->servicing_softirq = servicing_softirq;
+	cpu_stat->steal_time = steal_time;
+	cpu_stat->guest_mode = guest_mode;
+	cpu_stat->guest_niced_mode = guest_niced_mode;
 }
 
 void ReadCPUUsageStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
@@ -135,12 +120,19 @@ void ReadCPUUsageStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
 
 	memset(nulls, 0, sizeof(nulls));
 
-	/* Take the first sample regarding cpu usage statistics */
-	cpu_stat_information(&first_sample);
-	/* sleep for the 100ms between 2 samples tp find cpu usage statistics */
-	usleep(150000);
-	/* Take the second sample regarding cpu usage statistics */
-	cpu_stat_information(&second_sample);
+	/*
+	 * Use the two most recent samples taken by the background sampler if it
+	 * is running, otherwise take two samples of our own.
+	 */
+	if (!ReadLatestCPUSamples(&first_sample, &second_sample))
+	{
+		/* Take the first sample regarding cpu usage statistics */
+		cpu_stat_information(&first_sample);
+		/* sleep for the 100ms between 2 samples tp find cpu usage statistics */
+		usleep(150000);
+		/* Take the second sample regarding cpu usage statistics */
+		cpu_stat_information(&second_sample);
+	}
 
 	delta_usermode_normal_process = (second_sample.usermode_normal_process - first_sample.usermode_normal_process);
 	delta_usermode_niced_process = (second_sample.usermode_niced_process - first_sample.usermode_niced_process);
@@ -187,3 +179,171 @@ void ReadCPUUsageStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
 
 	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 }
+
+/*
+ * Parse the cpuN lines of /proc/stat into a palloc'd array with one entry
+ * per online CPU, ordered by CPU id, in a single read of the file. Fields
+ * missing on older kernels are left to zero. Returns the number of
+ * entries, or -1 if the file can not be read.
+ */
+int ReadCPUCoreStats(cpu_core_stat **core_stats)
+{
+	char          *buf;
+	char          *line;
+	char          *next;
+	int           num_cores = 0;
+	int           max_cores = 0;
+	cpu_core_stat *stats = NULL;
+	cpu_core_stat core;
+
+	buf = ReadCachedProcFile(CPU_USAGE_STATS_FILENAME, NULL);
+	if (buf == NULL)
+		return -1;
+
+	/* The cpu lines come first, the aggregate one followed by one per CPU */
+	for (line = buf; line != NULL && strncmp(line, "cpu", 3) == 0; line = next)
+	{
+		next = strchr(line, '\n');
+		if (next != NULL)
+			*next++ = '\0';
+
+		if (!isdigit((unsigned char) line[3]))
+			continue;
+
+		memset(&core, 0, sizeof(core));
+		if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+				   &core.cpu_id,
+				   &core.stat.usermode_normal_process,
+				   &core.stat.usermode_niced_process,
+				   &core.stat.kernelmode_process,
+				   &core.stat.idle_mode,
+				   &core.stat.io_completion,
+				   &core.stat.servicing_irq,
+				   &core.stat.servicing_softirq,
+				   &core.stat.steal_time,
+				   &core.stat.guest_mode,
+				   &core.stat.guest_niced_mode) < 5)
+			continue;
+
+		if (num_cores >= max_cores)
+		{
+			max_cores = Max(max_cores * 2, 16);
+			stats = (stats == NULL) ? (cpu_core_stat *) palloc(max_cores * sizeof(cpu_core_stat)) :
+				(cpu_core_stat *) repalloc(stats, max_cores * sizeof(cpu_core_stat));
+		}
+		stats[num_cores++] = core;
+	}
+
+	*core_stats = stats;
+	return num_cores;
+}
+
+/* Take a per CPU sample in the context which keeps the previous sample */
+static int take_cpu_core_sample(cpu_core_stat **core_stats)
+{
+	MemoryContext oldcontext;
+	int           num_cores;
+
+	if (CPUCoreSampleContext == NULL)
+		CPUCoreSampleContext = AllocSetContextCreate(TopMemoryContext,
+													 "system_stats per CPU sample",
+													 ALLOCSET_SMALL_SIZES);
+
+	oldcontext = MemoryContextSwitchTo(CPUCoreSampleContext);
+	num_cores = ReadCPUCoreStats(core_stats);
+	MemoryContextSwitchTo(oldcontext);
+
+	return num_cores;
+}
+
+/*
+ * Usage of each CPU, in percentage of its time spent in each mode. The
+ * deltas are computed against the previous sample taken by this backend,
+ * so a monitoring session polling regularly gets the usage since its last
+ * poll without any wait. Without a previous sample younger than
+ * PREVIOUS_SAMPLE_MAX_AGE_MS, two samples are taken
+ * CPU_CORE_SAMPLE_INTERVAL_MS apart.
+ */
+void ReadCPUUsagePerCore(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum         values[Natts_cpu_usage_per_core];
+	bool          nulls[Natts_cpu_usage_per_core];
+	cpu_core_stat *current_stats;
+	int           num_cores;
+	int           index;
+	int           previous = 0;
+
+	memset(nulls, 0, sizeof(nulls));
+
+	if (previous_core_stats == NULL ||
+		PreviousSampleExpired(previous_core_sample_time))
+	{
+		if (previous_core_stats != NULL)
+			pfree(previous_core_stats);
+		previous_core_stats = NULL;
+
+		previous_num_cores = take_cpu_core_sample(&previous_core_stats);
+		if (previous_num_cores <= 0)
+			return;
+		previous_core_sample_time = GetCurrentTimestamp();
+	}
+
+	/* Wait for the part of the sampling interval that has not elapsed yet */
+	WaitSampleInterval(previous_core_sample_time, CPU_CORE_SAMPLE_INTERVAL_MS);
+
+	num_cores = take_cpu_core_sample(&current_stats);
+	if (num_cores <= 0)
+		return;
+
+	for (index = 0; index < num_cores; index++)
+	{
+		struct cpu_stat *second = &current_stats[index].stat;
+		struct cpu_stat *first;
+		long long int   total_delta;
+		float           scale = 100.0;
+
+		/* Both samples are ordered by CPU id, CPUs may go online or offline */
+		while (previous < previous_num_cores &&
+			   previous_core_stats[previous].cpu_id < current_stats[index].cpu_id)
+			previous++;
+
+		if (previous >= previous_num_cores ||
+			previous_core_stats[previous].cpu_id != current_stats[index].cpu_id)
+			continue;
+
+		first = &previous_core_stats[previous].stat;
+
+		/* guest time is already accounted in user and nice time */
+		total_delta = (second->usermode_normal_process - first->usermode_normal_process) +
+			(second->usermode_niced_process - first->usermode_niced_process) +
+			(second->kernelmode_process - first->kernelmode_process) +
+			(second->idle_mode - first->idle_mode) +
+			(second->io_completion - first->io_completion) +
+			(second->servicing_irq - first->servicing_irq) +
+			(second->servicing_softirq - first->servicing_softirq) +
+			(second->steal_time - first->steal_time);
+
+		if (total_delta != 0)
+			scale = (float)100/(float)total_delta;
+
+		values[Anum_core_cpu_id] = Int32GetDatum(current_stats[index].cpu_id);
+		values[Anum_core_usermode_normal_process] = Float4GetDatum(fl_round((second->usermode_normal_process - first->usermode_normal_process) * scale));
+		values[Anum_core_usermode_niced_process] = Float4GetDatum(fl_round((second->usermode_niced_process - first->usermode_niced_process) * scale));
+		values[Anum_core_kernelmode_process] = Float4GetDatum(fl_round((second->kernelmode_process - first->kernelmode_process) * scale));
+		values[Anum_core_idle_mode] = Float4GetDatum(fl_round((second->idle_mode - first->idle_mode) * scale));
+		values[Anum_core_io_completion] = Float4GetDatum(fl_round((second->io_completion - first->io_completion) * scale));
+		values[Anum_core_servicing_irq] = Float4GetDatum(fl_round((second->servicing_irq - first->servicing_irq) * scale));
+		values[Anum_core_servicing_softirq] = Float4GetDatum(fl_round((second->servicing_softirq - first->servicing_softirq) * scale));
+		values[Anum_core_steal_time] = Float4GetDatum(fl_round((second->steal_time - first->steal_time) * scale));
+		values[Anum_core_guest_mode] = Float4GetDatum(fl_round((second->guest_mode - first->guest_mode) * scale));
+		values[Anum_core_guest_niced_mode] = Float4GetDatum(fl_round((second->guest_niced_mode - first->guest_niced_mode) * scale));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* The current sample is the previous one of the next call */
+	pfree(previous_core_stats);
+	previous_core_stats = current_stats;
+	previous_num_cores = num_cores;
+	previous_core_sample_time = GetCurrentTimestamp();
+}
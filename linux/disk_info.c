@@ -10,83 +10,258 @@
 #include "postgres.h"
 
 #include <mntent.h>
-#include <regex.h>
 #include <sys/statvfs.h>
 
 #include "system_stats.h"
 
+#include "nodes/pg_list.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/varlena.h"
+
 void ReadDiskInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
-/* This function is used to ignore the file system types */
-bool ignoreFileSystemTypes(char *fs_mnt)
+/*
+ * Node of the trie of ignored mount points, with one level per path
+ * component. ignore_self ignores the path itself, ignore_descendants
+ * ignores every path below it.
+ */
+typedef struct mount_point_node
+{
+	char                    *name;
+	bool                    ignore_self;
+	bool                    ignore_descendants;
+	struct mount_point_node *first_child;
+	struct mount_point_node *next_sibling;
+} mount_point_node;
+
+/* GUC variables */
+static char *ignore_file_system_types = NULL;
+static char *ignore_mount_points = NULL;
+
+/* filters built from the GUC variables, rebuilt when they change */
+static MemoryContext    MountFilterContext = NULL;
+static HTAB             *ignored_file_system_types = NULL;
+static mount_point_node *ignored_mount_points = NULL;
+static bool             mount_filters_valid = false;
+
+static bool check_ignore_list(char **newval, void **extra, GucSource source);
+static void assign_ignore_list(const char *newval, void *extra);
+static void BuildMountFilters(void);
+static mount_point_node *find_mount_point_child(mount_point_node *node, const char *name, int name_len);
+static void add_ignored_mount_point(mount_point_node *root, const char *path);
+
+/* Define the GUCs used to configure the file systems to ignore */
+void InitDiskInfoFilters(void)
 {
-	regex_t regex;
-	int reg_return;
-	bool ret_value = false;
+	DefineCustomStringVariable("system_stats.ignore_file_system_types",
+							   "Comma separated list of file system types ignored by pg_sys_disk_info.",
+							   NULL,
+							   &ignore_file_system_types,
+							   IGNORE_FILE_SYSTEM_TYPES_DEFAULT,
+							   PGC_SUSET,
+							   GUC_LIST_INPUT,
+							   check_ignore_list,
+							   assign_ignore_list,
+							   NULL);
 
-	reg_return = regcomp(&regex, IGNORE_FILE_SYSTEM_TYPE_REGEX, REG_EXTENDED);
-	if (reg_return)
+	DefineCustomStringVariable("system_stats.ignore_mount_points",
+							   "Comma separated list of mount points ignored by pg_sys_disk_info.",
+							   "Every mount point below a listed path is ignored as well. "
+							   "A path ending with a slash only ignores the mount points below it.",
+							   &ignore_mount_points,
+							   IGNORE_MOUNT_POINTS_DEFAULT,
+							   PGC_SUSET,
+							   GUC_LIST_INPUT,
+							   check_ignore_list,
+							   assign_ignore_list,
+							   NULL);
+}
+
+/* Check that the value of an ignore list GUC is a valid list */
+static bool check_ignore_list(char **newval, void **extra, GucSource source)
+{
+	char *rawstring;
+	List *elemlist;
+	bool valid;
+
+	rawstring = pstrdup(*newval);
+	valid = SplitGUCList(rawstring, ',', &elemlist);
+	list_free(elemlist);
+	pfree(rawstring);
+
+	if (!valid)
+		GUC_check_errdetail("List syntax is invalid.");
+
+	return valid;
+}
+
+/* Force the filters to be rebuilt on next use */
+static void assign_ignore_list(const char *newval, void *extra)
+{
+	mount_filters_valid = false;
+}
+
+/* Find the child of given node for given path component */
+static mount_point_node *find_mount_point_child(mount_point_node *node, const char *name, int name_len)
+{
+	mount_point_node *child;
+
+	for (child = node->first_child; child != NULL; child = child->next_sibling)
 	{
-		ereport(DEBUG1,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				errmsg("Could not compile regex")));
-		return ret_value;
+		if (strncmp(child->name, name, name_len) == 0 && child->name[name_len] == '\0')
+			return child;
+	}
+
+	return NULL;
+}
+
+/* Add given path to the trie of ignored mount points */
+static void add_ignored_mount_point(mount_point_node *root, const char *path)
+{
+	mount_point_node *node = root;
+	mount_point_node *child;
+	const char       *component = path;
+	int              len;
+	bool             descendants_only = false;
+
+	len = strlen(path);
+	if (len > 1 && path[len - 1] == '/')
+		descendants_only = true;
+
+	while (*component == '/')
+		component++;
+
+	while (*component != '\0')
+	{
+		len = strcspn(component, "/");
+
+		child = find_mount_point_child(node, component, len);
+		if (child == NULL)
+		{
+			child = (mount_point_node *) palloc0(sizeof(mount_point_node));
+			child->name = pnstrdup(component, len);
+			child->next_sibling = node->first_child;
+			node->first_child = child;
+		}
+
+		node = child;
+		component += len;
+		while (*component == '/')
+			component++;
 	}
 
-	/* Execute regular expression */
-	reg_return = regexec(&regex, fs_mnt, 0, NULL, 0);
-	if (!reg_return)
-		ret_value = true;
-	else if (reg_return == REG_NOMATCH)
-		ret_value = false;
+	if (!descendants_only)
+		node->ignore_self = true;
+	node->ignore_descendants = true;
+}
+
+/*
+ * Build the hash set of ignored file system types and the trie of ignored
+ * mount points once, instead of compiling a regular expression for every
+ * mount entry.
+ */
+static void BuildMountFilters(void)
+{
+	MemoryContext oldcontext;
+	HASHCTL       ctl;
+	char          *rawstring;
+	List          *elemlist;
+	ListCell      *lc;
+
+	if (MountFilterContext == NULL)
+		MountFilterContext = AllocSetContextCreate(TopMemoryContext,
+												   "system_stats mount filters",
+												   ALLOCSET_SMALL_SIZES);
 	else
+		MemoryContextReset(MountFilterContext);
+
+	oldcontext = MemoryContextSwitchTo(MountFilterContext);
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = NAMEDATALEN;
+	ctl.entrysize = NAMEDATALEN;
+	ctl.hcxt = MountFilterContext;
+#if PG_VERSION_NUM >= 140000
+	ignored_file_system_types = hash_create("system_stats ignored file system types",
+											32, &ctl, HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+#else
+	/* Keys are hashed as strings by default before PostgreSQL 14 */
+	ignored_file_system_types = hash_create("system_stats ignored file system types",
+											32, &ctl, HASH_ELEM | HASH_CONTEXT);
+#endif
+
+	rawstring = pstrdup(ignore_file_system_types);
+	if (SplitGUCList(rawstring, ',', &elemlist))
 	{
-		ret_value = false;
-		ereport(DEBUG1,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				errmsg("regex match failed")));
+		foreach(lc, elemlist)
+		{
+			char fs_type[NAMEDATALEN];
+
+			strlcpy(fs_type, (char *) lfirst(lc), NAMEDATALEN);
+			(void) hash_search(ignored_file_system_types, fs_type, HASH_ENTER, NULL);
+		}
 	}
 
-	/* Free memory allocated to the pattern buffer by regcomp() */
-	regfree(&regex);
+	ignored_mount_points = (mount_point_node *) palloc0(sizeof(mount_point_node));
 
-	return ret_value;
+	rawstring = pstrdup(ignore_mount_points);
+	if (SplitGUCList(rawstring, ',', &elemlist))
+	{
+		foreach(lc, elemlist)
+			add_ignored_mount_point(ignored_mount_points, (char *) lfirst(lc));
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	mount_filters_valid = true;
+}
+
+/* This function is used to ignore the file system types */
+bool ignoreFileSystemTypes(char *fs_mnt)
+{
+	char fs_type[NAMEDATALEN];
+
+	if (!mount_filters_valid)
+		BuildMountFilters();
+
+	strlcpy(fs_type, fs_mnt, NAMEDATALEN);
+
+	return hash_search(ignored_file_system_types, fs_type, HASH_FIND, NULL) != NULL;
 }
 
 /* This function is used to ignore the mount points */
 bool ignoreMountPoints(char *fs_mnt)
 {
-	regex_t regex;
-	int reg_return;
-	bool ret_value = false;
+	mount_point_node *node;
+	const char       *component = fs_mnt;
+	int              len;
 
-	reg_return = regcomp(&regex, IGNORE_MOUNT_POINTS_REGEX, REG_EXTENDED);
-	if (reg_return)
-	{
-		ereport(DEBUG1,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				errmsg("Could not compile regex")));
-		return ret_value;
-	}
+	if (!mount_filters_valid)
+		BuildMountFilters();
 
-	/* Execute regular expression */
-	reg_return = regexec(&regex, fs_mnt, 0, NULL, 0);
-	if (!reg_return)
-		ret_value = true;
-	else if (reg_return == REG_NOMATCH)
-		ret_value = false;
-	else
+	node = ignored_mount_points;
+
+	while (*component == '/')
+		component++;
+
+	while (*component != '\0')
 	{
-		ret_value = false;
-		ereport(DEBUG1,
-				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-				errmsg("regex match failed")));
-	}
+		if (node->ignore_descendants)
+			return true;
 
-	/* Free memory allocated to the pattern buffer by regcomp() */
-	regfree(&regex);
+		len = strcspn(component, "/");
+		node = find_mount_point_child(node, component, len);
+		if (node == NULL)
+			return false;
+
+		component += len;
+		while (*component == '/')
+			component++;
+	}
 
-	return ret_value;
+	return node->ignore_self;
 }
 
 void ReadDiskInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
@@ -130,7 +305,7 @@ void ReadDiskInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
 
 		while ((ent = getmntent(fp)) != NULL)
 		{
-			if (ignoreFileSystemTypes(ent->mnt_fsname) || ignoreMountPoints(ent->mnt_dir))
+			if (ignoreFileSystemTypes(ent->mnt_type) || ignoreMountPoints(ent->mnt_dir))
 				continue;
 
 			memset(&buf, 0, sizeof(buf));
@@ -0,0 +1,413 @@
+/*------------------------------------------------------------------------
+ * huge_pages_info.c
+ *              Huge pages, transparent huge pages and the pages of the
+ *              shared memory segment of the server
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "miscadmin.h"
+
+#include <ctype.h>
+#include <limits.h>
+
+/* fields of /proc/vmstat reported by ReadSharedMemoryInformation */
+typedef enum thp_vmstat_field
+{
+	THP_COMPACT_STALL,
+	THP_COMPACT_FAIL,
+	THP_COMPACT_SUCCESS,
+	THP_FAULT_ALLOC,
+	THP_FAULT_FALLBACK,
+	THP_COLLAPSE_ALLOC,
+	THP_NUM_VMSTAT_FIELDS
+} thp_vmstat_field;
+
+/* names of the fields, in the order of thp_vmstat_field */
+static const char *const thp_vmstat_keys[THP_NUM_VMSTAT_FIELDS] = {
+	"compact_stall",
+	"compact_fail",
+	"compact_success",
+	"thp_fault_alloc",
+	"thp_fault_fallback",
+	"thp_collapse_alloc"
+};
+
+/*
+ * Files of the mappings of the main shared memory segment in /proc/<pid>/smaps:
+ * an anonymous shared mapping, backed by huge pages or not, or a System V
+ * segment when shared_memory_type is sysv.
+ */
+static const char *const shared_memory_mapping_files[] = {
+	"/dev/zero",
+	"/anon_hugepage",
+	"/SYSV"
+};
+
+/* memory of the mappings of the main shared memory segment, in bytes */
+typedef struct shared_memory_stats
+{
+	uint64 size;
+	uint64 page_size;
+	uint64 rss;
+	uint64 hugetlb;
+	uint64 anon_huge_pages;
+	uint64 shmem_pmd_mapped;
+} shared_memory_stats;
+
+/* size of the huge page pool of the sysfs directory, see compare_huge_page_sizes */
+typedef struct huge_page_pool
+{
+	uint64 page_size;
+	char   dir_name[NAME_MAX + 1];
+} huge_page_pool;
+
+void ReadHugePagesInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadSharedMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+static int64 read_huge_pages_value(const char *dir_name, const char *file_name);
+static bool read_shared_memory_mappings(shared_memory_stats *stats);
+static bool read_thp_mode(const char *file_name, char *mode, int len);
+static int compare_huge_page_sizes(const void *a, const void *b);
+
+/*
+ * Read a file of a huge page pool directory holding a number of pages.
+ * Returns -1 if it can not be read.
+ */
+static int64 read_huge_pages_value(const char *dir_name, const char *file_name)
+{
+	char  path[MAXPGPATH];
+	char  *content;
+	int64 value = -1;
+
+	snprintf(path, MAXPGPATH, "%s/%s/%s", HUGE_PAGES_DIRECTORY, dir_name, file_name);
+
+	content = ReadProcFile(path, NULL);
+	if (content == NULL)
+		return -1;
+
+	if (isdigit((unsigned char) content[0]))
+		value = (int64) strtoull(content, NULL, 10);
+
+	pfree(content);
+
+	return value;
+}
+
+/*
+ * Sum the memory of the mappings of the main shared memory segment of the
+ * server from /proc/<postmaster>/smaps. Each mapping starts with a
+ * "<start>-<end> <perms> <offset> <dev> <inode> <path>" line followed by
+ * its "<Field>: <value> kB" lines. The page size is the one of the largest
+ * mapping. Returns false if the file can not be read or has no such mapping.
+ */
+static bool read_shared_memory_mappings(shared_memory_stats *stats)
+{
+	char               file_name[MAXPGPATH];
+	char               perms[5];
+	char               *content;
+	char               *line;
+	char               *next_line;
+	char               *path;
+	char               *colon;
+	unsigned long long value;
+	uint64             largest = 0;
+	uint64             mapping_size = 0;
+	bool               in_segment = false;
+	bool               found = false;
+	int                path_offset;
+	int                index;
+
+	memset(stats, 0, sizeof(shared_memory_stats));
+
+	snprintf(file_name, MAXPGPATH, "%s/%d/smaps", PROC_FILE_SYSTEM_PATH, PostmasterPid);
+	content = ReadProcFile(file_name, NULL);
+	if (content == NULL)
+		return false;
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		path_offset = 0;
+		if (sscanf(line, "%*x-%*x %4s %*s %*s %*s %n", perms, &path_offset) == 1 && path_offset > 0)
+		{
+			path = line + path_offset;
+			in_segment = false;
+
+			/* The segment is shared, unlike the private mappings of /dev/zero */
+			for (index = 0; index < lengthof(shared_memory_mapping_files) && perms[3] == 's'; index++)
+			{
+				if (strncmp(path, shared_memory_mapping_files[index],
+							strlen(shared_memory_mapping_files[index])) == 0)
+					in_segment = true;
+			}
+
+			found |= in_segment;
+			continue;
+		}
+
+		colon = strchr(line, ':');
+		if (!in_segment || colon == NULL || sscanf(colon + 1, "%llu", &value) != 1)
+			continue;
+
+		value *= 1024;
+
+		if (strncmp(line, "Size:", 5) == 0)
+		{
+			mapping_size = value;
+			stats->size += value;
+		}
+		else if (strncmp(line, "KernelPageSize:", 15) == 0)
+		{
+			if (mapping_size >= largest)
+			{
+				largest = mapping_size;
+				stats->page_size = value;
+			}
+		}
+		else if (strncmp(line, "Rss:", 4) == 0)
+			stats->rss += value;
+		else if (strncmp(line, "AnonHugePages:", 14) == 0)
+			stats->anon_huge_pages += value;
+		else if (strncmp(line, "ShmemPmdMapped:", 15) == 0)
+			stats->shmem_pmd_mapped += value;
+		else if (strncmp(line, "Shared_Hugetlb:", 15) == 0 ||
+				 strncmp(line, "Private_Hugetlb:", 16) == 0)
+			stats->hugetlb += value;
+	}
+
+	pfree(content);
+
+	return found;
+}
+
+/*
+ * Read the selected mode of a transparent huge page setting, shown between
+ * brackets among the possible modes, as in "always [madvise] never".
+ */
+static bool read_thp_mode(const char *file_name, char *mode, int len)
+{
+	char path[MAXPGPATH];
+	char *content;
+	char *start;
+	char *end;
+
+	snprintf(path, MAXPGPATH, "%s/%s", THP_DIRECTORY, file_name);
+
+	content = ReadProcFile(path, NULL);
+	if (content == NULL)
+		return false;
+
+	if ((start = strchr(content, '[')) == NULL || (end = strchr(start, ']')) == NULL)
+	{
+		pfree(content);
+		return false;
+	}
+
+	*end = '\0';
+	strlcpy(mode, start + 1, len);
+	pfree(content);
+
+	return true;
+}
+
+static int compare_huge_page_sizes(const void *a, const void *b)
+{
+	uint64 left = ((const huge_page_pool *) a)->page_size;
+	uint64 right = ((const huge_page_pool *) b)->page_size;
+
+	return (left > right) - (left < right);
+}
+
+/*
+ * Report one row per huge page size from the hugepages-<size>kB
+ * directories of /sys/kernel/mm/hugepages, ordered by page size, with the
+ * bytes of the main shared memory segment of the server backed by pages
+ * of that size. The default size is the one of the HugePages_* fields of
+ * /proc/meminfo, used when huge_page_size is 0.
+ */
+void ReadHugePagesInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum               values[Natts_huge_pages_info];
+	bool                nulls[Natts_huge_pages_info];
+	proc_dir_reader     reader;
+	const char          *name;
+	huge_page_pool      *pools;
+	int                 num_pools = 0;
+	int                 max_pools = 4;
+	int                 index;
+	unsigned long long  size_kb;
+	meminfo_stats       meminfo;
+	shared_memory_stats shared;
+	bool                shared_present;
+	int64               value;
+
+	if (!ProcDirOpen(&reader, HUGE_PAGES_DIRECTORY))
+		return;
+
+	pools = (huge_page_pool *) palloc(max_pools * sizeof(huge_page_pool));
+
+	while ((name = ProcDirNextEntry(&reader)) != NULL)
+	{
+		if (sscanf(name, "hugepages-%llukB", &size_kb) != 1)
+			continue;
+
+		if (num_pools == max_pools)
+		{
+			max_pools *= 2;
+			pools = (huge_page_pool *) repalloc(pools, max_pools * sizeof(huge_page_pool));
+		}
+
+		pools[num_pools].page_size = (uint64) size_kb * 1024;
+		strlcpy(pools[num_pools].dir_name, name, sizeof(pools[num_pools].dir_name));
+		num_pools++;
+	}
+
+	ProcDirClose(&reader);
+
+	qsort(pools, num_pools, sizeof(huge_page_pool), compare_huge_page_sizes);
+
+	if (!ReadMemInfo(&meminfo))
+		memset(&meminfo, 0, sizeof(meminfo));
+
+	shared_present = read_shared_memory_mappings(&shared);
+
+	for (index = 0; index < num_pools; index++)
+	{
+		huge_page_pool *pool = &pools[index];
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[Anum_huge_pages_page_size] = Int64GetDatumFast(pool->page_size);
+
+		if (meminfo.present[MEMINFO_HUGEPAGESIZE])
+			values[Anum_huge_pages_is_default] = BoolGetDatum(meminfo.values[MEMINFO_HUGEPAGESIZE] == pool->page_size);
+		else
+			nulls[Anum_huge_pages_is_default] = true;
+
+#define HUGE_PAGES_COLUMN(column, file_name) \
+		do { \
+			value = read_huge_pages_value(pool->dir_name, file_name); \
+			if (value >= 0) \
+				values[column] = Int64GetDatumFast(value); \
+			else \
+				nulls[column] = true; \
+		} while (0)
+
+		HUGE_PAGES_COLUMN(Anum_huge_pages_total, "nr_hugepages");
+		HUGE_PAGES_COLUMN(Anum_huge_pages_free, "free_hugepages");
+		HUGE_PAGES_COLUMN(Anum_huge_pages_reserved, "resv_hugepages");
+		HUGE_PAGES_COLUMN(Anum_huge_pages_surplus, "surplus_hugepages");
+
+#undef HUGE_PAGES_COLUMN
+
+		if (shared_present)
+			values[Anum_huge_pages_shared_memory_bytes] =
+				Int64GetDatum(shared.page_size == pool->page_size ? shared.hugetlb : 0);
+		else
+			nulls[Anum_huge_pages_shared_memory_bytes] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	pfree(pools);
+}
+
+/*
+ * Report, as one row, the pages backing the main shared memory segment of
+ * the server, read from the smaps file of the postmaster, together with
+ * the transparent huge page settings and the compaction and transparent
+ * huge page counters of /proc/vmstat. Memory is in bytes. The segment is
+ * on huge pages when huge_pages took effect, and otherwise may be partly
+ * mapped with transparent huge pages, depending on shmem_enabled. The
+ * compaction stalls count the allocations that had to wait for memory to
+ * be compacted.
+ */
+void ReadSharedMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum               values[Natts_shared_memory_info];
+	bool                nulls[Natts_shared_memory_info];
+	shared_memory_stats shared;
+	char                mode[MIN_BUFFER_SIZE];
+	char                key[MIN_BUFFER_SIZE];
+	char                *content;
+	char                *line;
+	char                *next_line;
+	unsigned long long  value;
+	int                 field;
+
+	memset(nulls, 0, sizeof(nulls));
+
+	if (read_shared_memory_mappings(&shared))
+	{
+		values[Anum_shared_memory_size] = Int64GetDatumFast(shared.size);
+		values[Anum_shared_memory_page_size] = Int64GetDatumFast(shared.page_size);
+		values[Anum_shared_memory_rss] = Int64GetDatumFast(shared.rss);
+		values[Anum_shared_memory_hugetlb] = Int64GetDatumFast(shared.hugetlb);
+		values[Anum_shared_memory_anon_huge_pages] = Int64GetDatumFast(shared.anon_huge_pages);
+		values[Anum_shared_memory_shmem_pmd_mapped] = Int64GetDatumFast(shared.shmem_pmd_mapped);
+	}
+	else
+	{
+		for (field = Anum_shared_memory_size; field <= Anum_shared_memory_shmem_pmd_mapped; field++)
+			nulls[field] = true;
+	}
+
+	if (read_thp_mode("enabled", mode, sizeof(mode)))
+		values[Anum_shared_memory_thp_enabled] = CStringGetTextDatum(mode);
+	else
+		nulls[Anum_shared_memory_thp_enabled] = true;
+
+	if (read_thp_mode("defrag", mode, sizeof(mode)))
+		values[Anum_shared_memory_thp_defrag] = CStringGetTextDatum(mode);
+	else
+		nulls[Anum_shared_memory_thp_defrag] = true;
+
+	if (read_thp_mode("shmem_enabled", mode, sizeof(mode)))
+		values[Anum_shared_memory_thp_shmem_enabled] = CStringGetTextDatum(mode);
+	else
+		nulls[Anum_shared_memory_thp_shmem_enabled] = true;
+
+	/* The counters of the kernels built without compaction or THP stay NULL */
+	for (field = 0; field < THP_NUM_VMSTAT_FIELDS; field++)
+		nulls[Anum_shared_memory_compact_stall + field] = true;
+
+	content = ReadProcFile(VMSTAT_FILE_NAME, NULL);
+	if (content == NULL)
+		ereport(DEBUG1,
+				(errmsg("can not read file %s for reading shared memory information",
+					VMSTAT_FILE_NAME)));
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		if (sscanf(line, "%127s %llu", key, &value) != 2)
+			continue;
+
+		for (field = 0; field < THP_NUM_VMSTAT_FIELDS; field++)
+		{
+			if (strcmp(key, thp_vmstat_keys[field]) == 0)
+			{
+				values[Anum_shared_memory_compact_stall + field] = Int64GetDatumFast((uint64) value);
+				nulls[Anum_shared_memory_compact_stall + field] = false;
+				break;
+			}
+		}
+	}
+
+	if (content != NULL)
+		pfree(content);
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
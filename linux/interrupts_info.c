@@ -0,0 +1,461 @@
+/*------------------------------------------------------------------------
+ * interrupts_info.c
+ *              Interrupts and softirqs serviced by each CPU
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "utils/timestamp.h"
+
+#include <ctype.h>
+
+/* interval between two samples when there is no recent previous sample */
+#define INTERRUPTS_SAMPLE_INTERVAL_MS     500
+/* length of the name and description of an interrupt line kept */
+#define INTERRUPT_NAME_LEN                32
+#define INTERRUPT_DESCRIPTION_LEN         128
+
+/* files of the lines of a sample, in the order of the sample */
+typedef enum interrupt_source
+{
+	INTERRUPT_SOURCE_SOFTIRQ,
+	INTERRUPT_SOURCE_IRQ
+} interrupt_source;
+
+static const char *const interrupt_source_names[] = {
+	"softirq",
+	"irq"
+};
+
+#define NUM_INTERRUPT_SOURCES    lengthof(interrupt_source_names)
+
+/* one line of /proc/softirqs or /proc/interrupts */
+typedef struct interrupt_line
+{
+	interrupt_source source;
+	char             name[INTERRUPT_NAME_LEN];
+	char             description[INTERRUPT_DESCRIPTION_LEN];
+	/* index of the counter of the first CPU of the line in counts */
+	Size             first_count;
+} interrupt_line;
+
+/*
+ * Counters of all the lines of both files. /proc/softirqs has a column per
+ * possible CPU but /proc/interrupts one per online CPU, so each source has
+ * its own CPUs. The counters of a line are counts[first_count] to
+ * counts[first_count + num_cpus[source] - 1], in the order of the
+ * cpu_ids of its source.
+ */
+typedef struct interrupt_sample
+{
+	TimestampTz    sample_time;
+	int            num_cpus[NUM_INTERRUPT_SOURCES];
+	int            *cpu_ids[NUM_INTERRUPT_SOURCES];
+	int            num_lines;
+	int            max_lines;
+	interrupt_line *lines;
+	Size           num_counts;
+	Size           max_counts;
+	uint64         *counts;
+} interrupt_sample;
+
+/* IRQ line of the current sample ranked by ReadInterruptsInformation */
+typedef struct interrupt_rank
+{
+	int    line;
+	uint64 delta;
+	uint64 total;
+} interrupt_rank;
+
+/* previous sample of this backend, see ReadInterruptsInformation */
+static MemoryContext    InterruptsSampleContext = NULL;
+static interrupt_sample *previous_interrupt_sample = NULL;
+
+void ReadInterruptsInformation(Tuplestorestate *tupstore, TupleDesc tupdesc, int num_lines);
+
+static int *parse_cpu_header(char *line, int *num_cpus);
+static bool parse_interrupts_file(const char *file_name, interrupt_source source, interrupt_sample *sample);
+static interrupt_sample *take_interrupt_sample(void);
+static void free_interrupt_sample(interrupt_sample *sample);
+static int find_interrupt_line(interrupt_sample *sample, interrupt_line *line, int hint);
+static int compare_interrupt_ranks(const void *a, const void *b);
+
+/*
+ * Parse the header line of the file, "CPU0 CPU1 ...", listing the CPUs of
+ * its columns. Returns a palloc'd array of their ids.
+ */
+static int *parse_cpu_header(char *line, int *num_cpus)
+{
+	int  *cpu_ids;
+	int  max_cpus = 16;
+	char *pos;
+
+	*num_cpus = 0;
+	cpu_ids = (int *) palloc(max_cpus * sizeof(int));
+
+	for (pos = strstr(line, "CPU"); pos != NULL; pos = strstr(pos, "CPU"))
+	{
+		pos += 3;
+
+		if (*num_cpus == max_cpus)
+		{
+			max_cpus *= 2;
+			cpu_ids = (int *) repalloc(cpu_ids, max_cpus * sizeof(int));
+		}
+		cpu_ids[(*num_cpus)++] = (int) strtol(pos, &pos, 10);
+	}
+
+	return cpu_ids;
+}
+
+/*
+ * Append the lines of /proc/softirqs or /proc/interrupts to the sample.
+ * Each line is "<name>: <count per CPU> [<description>]", one column per
+ * CPU of the header, which is a thousand characters wide on large
+ * machines, so the counters are parsed in place instead of being split
+ * into fields. Lines with fewer counters than CPUs, such as the ERR and
+ * MIS lines of x86, are counters of the whole system and are left out.
+ * The file spans many pages on such machines and is read to the end of
+ * file with ReadProcFile. Returns false if the file can not be read or
+ * lists no CPU.
+ */
+static bool parse_interrupts_file(const char *file_name, interrupt_source source, interrupt_sample *sample)
+{
+	char           *content;
+	char           *line;
+	char           *next_line;
+	char           *pos;
+	char           *colon;
+	char           *end;
+	int            num_cpus;
+	int            cpu;
+	int            len;
+	uint64         *counts;
+	interrupt_line *entry;
+
+	content = ReadProcFile(file_name, NULL);
+	if (content == NULL)
+	{
+		ereport(DEBUG1,
+				(errmsg("can not read file %s for reading interrupts information", file_name)));
+		return false;
+	}
+
+	next_line = strchr(content, '\n');
+	if (next_line == NULL)
+	{
+		pfree(content);
+		return false;
+	}
+	*next_line++ = '\0';
+
+	sample->cpu_ids[source] = parse_cpu_header(content, &num_cpus);
+	sample->num_cpus[source] = num_cpus;
+
+	if (num_cpus == 0)
+	{
+		pfree(content);
+		return false;
+	}
+
+	for (line = next_line; line != NULL && *line != '\0'; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		colon = strchr(line, ':');
+		if (colon == NULL)
+			continue;
+
+		if (sample->num_lines == sample->max_lines)
+		{
+			sample->max_lines *= 2;
+			sample->lines = (interrupt_line *) repalloc(sample->lines, sample->max_lines * sizeof(interrupt_line));
+		}
+
+		while (sample->num_counts + num_cpus > sample->max_counts)
+		{
+			sample->max_counts *= 2;
+			sample->counts = (uint64 *) repalloc(sample->counts, sample->max_counts * sizeof(uint64));
+		}
+
+		entry = &sample->lines[sample->num_lines];
+		entry->first_count = sample->num_counts;
+		counts = &sample->counts[entry->first_count];
+
+		for (pos = line; *pos == ' '; pos++)
+			;
+		len = Min(colon - pos, INTERRUPT_NAME_LEN - 1);
+		memcpy(entry->name, pos, len);
+		entry->name[len] = '\0';
+		entry->source = source;
+
+		pos = colon + 1;
+		for (cpu = 0; cpu < num_cpus; cpu++)
+		{
+			while (*pos == ' ')
+				pos++;
+			if (!isdigit((unsigned char) *pos))
+				break;
+
+			counts[cpu] = strtoull(pos, &end, 10);
+			pos = end;
+		}
+
+		if (cpu < num_cpus)
+			continue;
+
+		/* The rest of the line names the controller, trigger and devices */
+		while (*pos == ' ')
+			pos++;
+		strlcpy(entry->description, pos, INTERRUPT_DESCRIPTION_LEN);
+
+		sample->num_lines++;
+		sample->num_counts += num_cpus;
+	}
+
+	pfree(content);
+
+	return true;
+}
+
+/* Read /proc/softirqs and /proc/interrupts in the context of the samples */
+static interrupt_sample *take_interrupt_sample(void)
+{
+	interrupt_sample *sample;
+	MemoryContext    oldcontext;
+
+	if (InterruptsSampleContext == NULL)
+		InterruptsSampleContext = AllocSetContextCreate(TopMemoryContext,
+														"system_stats interrupts sample",
+														ALLOCSET_DEFAULT_SIZES);
+
+	oldcontext = MemoryContextSwitchTo(InterruptsSampleContext);
+
+	sample = (interrupt_sample *) palloc0(sizeof(interrupt_sample));
+	sample->sample_time = GetCurrentTimestamp();
+	sample->max_lines = 64;
+	sample->lines = (interrupt_line *) palloc(sample->max_lines * sizeof(interrupt_line));
+	sample->max_counts = 1024;
+	sample->counts = (uint64 *) palloc(sample->max_counts * sizeof(uint64));
+
+	if (!parse_interrupts_file(SOFTIRQS_FILE_NAME, INTERRUPT_SOURCE_SOFTIRQ, sample) ||
+		!parse_interrupts_file(INTERRUPTS_FILE_NAME, INTERRUPT_SOURCE_IRQ, sample))
+	{
+		free_interrupt_sample(sample);
+		sample = NULL;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return sample;
+}
+
+static void free_interrupt_sample(interrupt_sample *sample)
+{
+	int source;
+
+	for (source = 0; source < NUM_INTERRUPT_SOURCES; source++)
+	{
+		if (sample->cpu_ids[source] != NULL)
+			pfree(sample->cpu_ids[source]);
+	}
+	pfree(sample->counts);
+	pfree(sample->lines);
+	pfree(sample);
+}
+
+/*
+ * Find the line of the sample with the source and name of given line. The
+ * lines are usually in the same order in both samples, so the line at the
+ * same index is tried first. Returns -1 if the line is not found.
+ */
+static int find_interrupt_line(interrupt_sample *sample, interrupt_line *line, int hint)
+{
+	int index;
+
+	if (hint < sample->num_lines && sample->lines[hint].source == line->source &&
+		strcmp(sample->lines[hint].name, line->name) == 0)
+		return hint;
+
+	for (index = 0; index < sample->num_lines; index++)
+	{
+		if (sample->lines[index].source == line->source &&
+			strcmp(sample->lines[index].name, line->name) == 0)
+			return index;
+	}
+
+	return -1;
+}
+
+/* Order the IRQ lines by decreasing delta, then by decreasing total */
+static int compare_interrupt_ranks(const void *a, const void *b)
+{
+	const interrupt_rank *left = (const interrupt_rank *) a;
+	const interrupt_rank *right = (const interrupt_rank *) b;
+
+	if (left->delta != right->delta)
+		return (left->delta < right->delta) ? 1 : -1;
+	if (left->total != right->total)
+		return (left->total < right->total) ? 1 : -1;
+	return 0;
+}
+
+/*
+ * Report the interrupts serviced by each CPU: one row per softirq and CPU
+ * from /proc/softirqs, and one row per CPU that serviced one of the
+ * num_lines IRQ lines of /proc/interrupts with the most interrupts over
+ * the interval, such as the queues of a network interface. The rates are
+ * computed against the previous call of this backend when it is recent
+ * enough, as for ReadIORates, otherwise two samples are taken
+ * INTERRUPTS_SAMPLE_INTERVAL_MS apart. The rates of a file are NULL when
+ * its CPUs changed since the previous sample, such as when a CPU went
+ * online or offline for /proc/interrupts.
+ */
+void ReadInterruptsInformation(Tuplestorestate *tupstore, TupleDesc tupdesc, int num_lines)
+{
+	Datum            values[Natts_interrupts_info];
+	bool             nulls[Natts_interrupts_info];
+	interrupt_sample *current;
+	interrupt_sample *previous;
+	interrupt_rank   *ranks;
+	int              num_ranks = 0;
+	int              *previous_lines;
+	int              index;
+	int              line;
+	int              cpu;
+	int              source;
+	int              num_cpus;
+	bool             same_cpus[NUM_INTERRUPT_SOURCES];
+	float8           interval_ms;
+	float8           seconds;
+	uint64           *counts;
+	uint64           *previous_counts;
+	uint64           delta;
+
+	if (previous_interrupt_sample == NULL ||
+		PreviousSampleExpired(previous_interrupt_sample->sample_time))
+	{
+		if (previous_interrupt_sample != NULL)
+			free_interrupt_sample(previous_interrupt_sample);
+
+		previous_interrupt_sample = take_interrupt_sample();
+		if (previous_interrupt_sample == NULL)
+			return;
+	}
+
+	/* Wait for the part of the sampling interval that has not elapsed yet */
+	WaitSampleInterval(previous_interrupt_sample->sample_time, INTERRUPTS_SAMPLE_INTERVAL_MS);
+
+	current = take_interrupt_sample();
+	if (current == NULL)
+		return;
+
+	previous = previous_interrupt_sample;
+	interval_ms = (current->sample_time - previous->sample_time) / 1000.0;
+	seconds = interval_ms / 1000.0;
+
+	/* Each file is compared only with the same file of the previous sample */
+	for (source = 0; source < NUM_INTERRUPT_SOURCES; source++)
+		same_cpus[source] = current->num_cpus[source] == previous->num_cpus[source] &&
+			memcmp(current->cpu_ids[source], previous->cpu_ids[source],
+				   current->num_cpus[source] * sizeof(int)) == 0 &&
+			seconds > 0;
+
+	/* Match the lines once, a line missing from the previous sample is charged all its interrupts */
+	previous_lines = (int *) palloc(Max(current->num_lines, 1) * sizeof(int));
+	ranks = (interrupt_rank *) palloc(Max(current->num_lines, 1) * sizeof(interrupt_rank));
+
+	for (line = 0; line < current->num_lines; line++)
+	{
+		source = current->lines[line].source;
+		previous_lines[line] = same_cpus[source] ?
+			find_interrupt_line(previous, &current->lines[line], line) : -1;
+
+		if (source != INTERRUPT_SOURCE_IRQ)
+			continue;
+
+		counts = &current->counts[current->lines[line].first_count];
+		previous_counts = (previous_lines[line] >= 0) ?
+			&previous->counts[previous->lines[previous_lines[line]].first_count] : NULL;
+
+		ranks[num_ranks].line = line;
+		ranks[num_ranks].delta = 0;
+		ranks[num_ranks].total = 0;
+		for (cpu = 0; cpu < current->num_cpus[source]; cpu++)
+		{
+			ranks[num_ranks].total += counts[cpu];
+			if (previous_counts != NULL && counts[cpu] >= previous_counts[cpu])
+				ranks[num_ranks].delta += counts[cpu] - previous_counts[cpu];
+			else if (previous_counts == NULL)
+				ranks[num_ranks].delta += counts[cpu];
+		}
+		num_ranks++;
+	}
+
+	qsort(ranks, num_ranks, sizeof(interrupt_rank), compare_interrupt_ranks);
+	num_ranks = Min(num_ranks, num_lines);
+
+	values[Anum_interrupts_interval_ms] = Float8GetDatum(interval_ms);
+
+	/* The softirqs come first in the sample, then the IRQ lines kept */
+	for (index = 0; index < current->num_lines + num_ranks; index++)
+	{
+		if (index < current->num_lines)
+		{
+			line = index;
+			if (current->lines[line].source != INTERRUPT_SOURCE_SOFTIRQ)
+				continue;
+		}
+		else
+			line = ranks[index - current->num_lines].line;
+
+		source = current->lines[line].source;
+		num_cpus = current->num_cpus[source];
+		counts = &current->counts[current->lines[line].first_count];
+		previous_counts = (previous_lines[line] >= 0) ?
+			&previous->counts[previous->lines[previous_lines[line]].first_count] : NULL;
+
+		for (cpu = 0; cpu < num_cpus; cpu++)
+		{
+			/* CPUs that never serviced the IRQ line only add noise */
+			if (source == INTERRUPT_SOURCE_IRQ && counts[cpu] == 0)
+				continue;
+
+			memset(nulls, 0, sizeof(nulls));
+
+			values[Anum_interrupts_source] = CStringGetTextDatum(interrupt_source_names[source]);
+			values[Anum_interrupts_name] = CStringGetTextDatum(current->lines[line].name);
+			if (current->lines[line].description[0] != '\0')
+				values[Anum_interrupts_description] = CStringGetTextDatum(current->lines[line].description);
+			else
+				nulls[Anum_interrupts_description] = true;
+			values[Anum_interrupts_cpu] = Int32GetDatum(current->cpu_ids[source][cpu]);
+			values[Anum_interrupts_count] = Int64GetDatum((int64) counts[cpu]);
+
+			if (!same_cpus[source])
+				nulls[Anum_interrupts_per_sec] = true;
+			else
+			{
+				delta = (previous_counts == NULL) ? counts[cpu] :
+					counts[cpu] - Min(previous_counts[cpu], counts[cpu]);
+				values[Anum_interrupts_per_sec] = Float8GetDatum(delta / seconds);
+			}
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	pfree(ranks);
+	pfree(previous_lines);
+
+	/* The current sample is the previous one of the next call */
+	free_interrupt_sample(previous_interrupt_sample);
+	previous_interrupt_sample = current;
+}
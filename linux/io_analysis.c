@@ -10,17 +10,115 @@
 #include "postgres.h"
 #include "system_stats.h"
 
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include <unistd.h>
+
+/* interval between two samples when there is no recent previous sample */
+#define IO_RATES_SAMPLE_INTERVAL_MS     500
+/* length of a device name, as in the kernel */
+#define DISK_NAME_LEN                   32
+
+/* structure used to store all the fields of one line of /proc/diskstats */
+typedef struct disk_io_stat
+{
+	unsigned int       major;
+	unsigned int       minor;
+	char               device_name[DISK_NAME_LEN];
+	int                num_fields;
+	unsigned long long reads;
+	unsigned long long reads_merged;
+	unsigned long long sectors_read;
+	unsigned long long read_ticks;
+	unsigned long long writes;
+	unsigned long long writes_merged;
+	unsigned long long sectors_written;
+	unsigned long long write_ticks;
+	unsigned long long in_flight;
+	unsigned long long io_ticks;
+	unsigned long long time_in_queue;
+	unsigned long long discards;
+	unsigned long long discards_merged;
+	unsigned long long sectors_discarded;
+	unsigned long long discard_ticks;
+	unsigned long long flushes;
+	unsigned long long flush_ticks;
+} disk_io_stat;
+
+/* previous sample of /proc/diskstats of this backend, see ReadIORates */
+static MemoryContext IORatesSampleContext = NULL;
+static disk_io_stat  *previous_disk_stats = NULL;
+static int           previous_num_disks = 0;
+static TimestampTz   previous_disk_sample_time = 0;
+
 void ReadIOAnalysisInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadIORates(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+static int take_disk_io_sample(disk_io_stat **disk_stats, TimestampTz *sample_time);
+
+/*
+ * Sum the I/O counters of /proc/diskstats over the disks backed by a device.
+ * Partitions and virtual block devices, such as loop, device mapper and
+ * software RAID devices, are left out so the I/O is not counted twice.
+ * Sectors are 512 bytes in /proc/diskstats whatever the size of the sectors
+ * of the device. Returns false if the file can not be read.
+ */
+bool ReadDiskIOTotals(uint64 *reads, uint64 *writes, uint64 *read_bytes, uint64 *write_bytes)
+{
+	char               *content;
+	char               *line_buf;
+	char               *next_line;
+	char               device_name[MAXPGPATH];
+	char               sys_path[MAXPGPATH];
+	char               *slash;
+	unsigned long long read_completed;
+	unsigned long long sector_read;
+	unsigned long long write_completed;
+	unsigned long long sector_written;
+	const char         *scan_fmt = "%*d %*d %s %llu %*u %llu %*u %llu %*u %llu";
+
+	*reads = *writes = *read_bytes = *write_bytes = 0;
+
+	content = ReadCachedProcFile(DISK_IO_STATS_FILE_NAME, NULL);
+	if (content == NULL)
+		return false;
+
+	for (line_buf = content; line_buf != NULL && *line_buf != '\0'; line_buf = next_line)
+	{
+		next_line = strchr(line_buf, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		if (sscanf(line_buf, scan_fmt, device_name, &read_completed, &sector_read,
+				   &write_completed, &sector_written) != 5)
+			continue;
+
+		/* sysfs replaces the slashes of device names such as cciss/c0d0 */
+		while ((slash = strchr(device_name, '/')) != NULL)
+			*slash = '!';
+
+		snprintf(sys_path, MAXPGPATH, "/sys/block/%s/device", device_name);
+		if (access(sys_path, F_OK) != 0)
+			continue;
+
+		*reads += read_completed;
+		*writes += write_completed;
+		*read_bytes += sector_read * 512;
+		*write_bytes += sector_written * 512;
+	}
+
+	return true;
+}
 
 /* Function used to get IO statistics of block devices */
 void ReadIOAnalysisInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
 {
-	FILE       *diskstats_file;
 	Datum      values[Natts_io_analysis_info];
 	bool       nulls[Natts_io_analysis_info];
+	char       *content;
 	char       *line_buf = NULL;
-	size_t     line_buf_size = 0;
-	ssize_t    line_size;
+	char       *next_line = NULL;
 	char       device_name[MAXPGPATH];
 	char       file_name[MAXPGPATH];
 	uint64     read_completed = 0;
@@ -40,9 +138,9 @@ void ReadIOAnalysisInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
 	sprintf(file_name, "/sys/block/sda/queue/hw_sector_size");
 	ReadFileContent(file_name, &sector_size);
 
-	diskstats_file = fopen(DISK_IO_STATS_FILE_NAME, "r");
+	content = ReadCachedProcFile(DISK_IO_STATS_FILE_NAME, NULL);
 
-	if (!diskstats_file)
+	if (content == NULL)
 	{
 		char disk_file_name[MAXPGPATH];
 		snprintf(disk_file_name, MAXPGPATH, "%s", DISK_IO_STATS_FILE_NAME);
@@ -54,12 +152,13 @@ void ReadIOAnalysisInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
 		return;
 	}
 
-	/* Get the first line of the file. */
-	line_size = getline(&line_buf, &line_buf_size, diskstats_file);
-
-	/* Loop through until we are done with the file. */
-	while (line_size >= 0)
+	/* Loop through the lines until we are done with the file. */
+	for (line_buf = content; line_buf != NULL && *line_buf != '\0'; line_buf = next_line)
 	{
+		next_line = strchr(line_buf, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
 		sscanf(line_buf, scan_fmt, device_name, &read_completed, &sector_read, &time_spent_reading_ms,
 		  &write_completed, &sector_written, &time_spent_writing_ms);
 
@@ -72,23 +171,207 @@ void ReadIOAnalysisInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
 		values[Anum_write_time_ms] = Int64GetDatumFast((uint64)time_spent_writing_ms);
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+}
+
+/*
+ * Parse all the fields of /proc/diskstats into a palloc'd array with one
+ * entry per device, in a single read of the file, in the context which
+ * keeps the previous sample. Kernels before 4.18 report no discard fields
+ * and kernels before 5.5 no flush fields, num_fields tells which ones were
+ * read. Returns the number of devices, or -1 if the file can not be read.
+ */
+static int take_disk_io_sample(disk_io_stat **disk_stats, TimestampTz *sample_time)
+{
+	char          *content;
+	char          *line_buf;
+	char          *next_line;
+	int           num_disks = 0;
+	int           max_disks = 0;
+	disk_io_stat  *stats = NULL;
+	disk_io_stat  disk;
+	MemoryContext oldcontext;
 
-                /* Free the allocated line buffer */
-                if (line_buf != NULL)
-                {
-                        free(line_buf);
-                        line_buf = NULL;
-                }
+	if (IORatesSampleContext == NULL)
+		IORatesSampleContext = AllocSetContextCreate(TopMemoryContext,
+													 "system_stats I/O rates sample",
+													 ALLOCSET_SMALL_SIZES);
 
-                /* Get the next line */
-                line_size = getline(&line_buf, &line_buf_size, diskstats_file);
+	content = ReadCachedProcFile(DISK_IO_STATS_FILE_NAME, NULL);
+	if (content == NULL)
+	{
+		ereport(DEBUG1,
+				(errmsg("can not read file %s for reading disk stats information",
+					DISK_IO_STATS_FILE_NAME)));
+		return -1;
 	}
 
-	if (line_buf != NULL)
+	*sample_time = GetCurrentTimestamp();
+
+	oldcontext = MemoryContextSwitchTo(IORatesSampleContext);
+
+	for (line_buf = content; line_buf != NULL && *line_buf != '\0'; line_buf = next_line)
 	{
-		free(line_buf);
-		line_buf = NULL;
+		next_line = strchr(line_buf, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		memset(&disk, 0, sizeof(disk));
+		disk.num_fields = sscanf(line_buf, "%u %u %31s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu"
+								 " %llu %llu %llu %llu %llu %llu",
+								 &disk.major, &disk.minor, disk.device_name,
+								 &disk.reads, &disk.reads_merged, &disk.sectors_read, &disk.read_ticks,
+								 &disk.writes, &disk.writes_merged, &disk.sectors_written, &disk.write_ticks,
+								 &disk.in_flight, &disk.io_ticks, &disk.time_in_queue,
+								 &disk.discards, &disk.discards_merged, &disk.sectors_discarded,
+								 &disk.discard_ticks, &disk.flushes, &disk.flush_ticks) - 3;
+
+		/* The fields up to the weighted time are there since Linux 2.6 */
+		if (disk.num_fields < 11)
+			continue;
+
+		if (num_disks >= max_disks)
+		{
+			max_disks = Max(max_disks * 2, 16);
+			stats = (stats == NULL) ? (disk_io_stat *) palloc(max_disks * sizeof(disk_io_stat)) :
+				(disk_io_stat *) repalloc(stats, max_disks * sizeof(disk_io_stat));
+		}
+		stats[num_disks++] = disk;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	*disk_stats = stats;
+	return num_disks;
+}
+
+/* Compute the average time of the requests completed in the interval */
+static float8 io_await(unsigned long long ticks, unsigned long long requests)
+{
+	return (requests > 0) ? (float8) ticks / requests : 0;
+}
+
+/*
+ * I/O rates of each block device, computed like iostat -x does from the
+ * deltas of /proc/diskstats. The deltas are computed against the previous
+ * sample taken by this backend, so a monitoring session polling regularly
+ * gets the rates since its last poll without any wait. Without a previous
+ * sample younger than PREVIOUS_SAMPLE_MAX_AGE_MS, two samples are taken
+ * IO_RATES_SAMPLE_INTERVAL_MS apart.
+ */
+void ReadIORates(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum         values[Natts_io_rates];
+	bool          nulls[Natts_io_rates];
+	disk_io_stat  *current_stats;
+	TimestampTz   current_sample_time;
+	int           num_disks;
+	int           index;
+	int           previous;
+	float8        seconds;
+	float8        interval_ms;
+
+	if (previous_disk_stats == NULL ||
+		PreviousSampleExpired(previous_disk_sample_time))
+	{
+		if (previous_disk_stats != NULL)
+			pfree(previous_disk_stats);
+		previous_disk_stats = NULL;
+
+		previous_num_disks = take_disk_io_sample(&previous_disk_stats, &previous_disk_sample_time);
+		if (previous_num_disks <= 0)
+			return;
+	}
+
+	/* Wait for the part of the sampling interval that has not elapsed yet */
+	WaitSampleInterval(previous_disk_sample_time, IO_RATES_SAMPLE_INTERVAL_MS);
+
+	num_disks = take_disk_io_sample(&current_stats, &current_sample_time);
+	if (num_disks <= 0)
+		return;
+
+	interval_ms = (current_sample_time - previous_disk_sample_time) / 1000.0;
+	seconds = interval_ms / 1000.0;
+
+	for (index = 0; index < num_disks; index++)
+	{
+		disk_io_stat *second = &current_stats[index];
+		disk_io_stat *first = NULL;
+
+		/* Devices are usually listed in the same order in both samples */
+		if (index < previous_num_disks && previous_disk_stats[index].major == second->major &&
+			previous_disk_stats[index].minor == second->minor)
+			first = &previous_disk_stats[index];
+		else
+		{
+			for (previous = 0; previous < previous_num_disks; previous++)
+			{
+				if (previous_disk_stats[previous].major == second->major &&
+					previous_disk_stats[previous].minor == second->minor)
+				{
+					first = &previous_disk_stats[previous];
+					break;
+				}
+			}
+		}
+
+		/* Skip a device that just appeared, or whose counters were reset */
+		if (first == NULL || seconds <= 0 || second->reads < first->reads || second->writes < first->writes)
+			continue;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[Anum_io_rates_device_name] = CStringGetTextDatum(second->device_name);
+		values[Anum_io_rates_reads] = Float8GetDatum((second->reads - first->reads) / seconds);
+		values[Anum_io_rates_writes] = Float8GetDatum((second->writes - first->writes) / seconds);
+		values[Anum_io_rates_read_mb] = Float8GetDatum((second->sectors_read - first->sectors_read) / 2048.0 / seconds);
+		values[Anum_io_rates_write_mb] = Float8GetDatum((second->sectors_written - first->sectors_written) / 2048.0 / seconds);
+		values[Anum_io_rates_reads_merged] = Float8GetDatum((second->reads_merged - first->reads_merged) / seconds);
+		values[Anum_io_rates_writes_merged] = Float8GetDatum((second->writes_merged - first->writes_merged) / seconds);
+		values[Anum_io_rates_read_await] = Float8GetDatum(io_await(second->read_ticks - first->read_ticks,
+																   second->reads - first->reads));
+		values[Anum_io_rates_write_await] = Float8GetDatum(io_await(second->write_ticks - first->write_ticks,
+																	second->writes - first->writes));
+		values[Anum_io_rates_await] = Float8GetDatum(io_await((second->read_ticks - first->read_ticks) +
+															  (second->write_ticks - first->write_ticks),
+															  (second->reads - first->reads) +
+															  (second->writes - first->writes)));
+		values[Anum_io_rates_avg_queue_size] = Float8GetDatum((second->time_in_queue - first->time_in_queue) / interval_ms);
+		values[Anum_io_rates_util] = Float8GetDatum(Min(100.0 * (second->io_ticks - first->io_ticks) / interval_ms, 100.0));
+		values[Anum_io_rates_in_flight] = Int64GetDatum((int64) second->in_flight);
+
+		if (second->num_fields >= 15 && first->num_fields >= 15)
+		{
+			values[Anum_io_rates_discards] = Float8GetDatum((second->discards - first->discards) / seconds);
+			values[Anum_io_rates_discard_mb] = Float8GetDatum((second->sectors_discarded - first->sectors_discarded) / 2048.0 / seconds);
+			values[Anum_io_rates_discard_await] = Float8GetDatum(io_await(second->discard_ticks - first->discard_ticks,
+																		  second->discards - first->discards));
+		}
+		else
+		{
+			nulls[Anum_io_rates_discards] = true;
+			nulls[Anum_io_rates_discard_mb] = true;
+			nulls[Anum_io_rates_discard_await] = true;
+		}
+
+		if (second->num_fields >= 17 && first->num_fields >= 17)
+		{
+			values[Anum_io_rates_flushes] = Float8GetDatum((second->flushes - first->flushes) / seconds);
+			values[Anum_io_rates_flush_await] = Float8GetDatum(io_await(second->flush_ticks - first->flush_ticks,
+																		second->flushes - first->flushes));
+		}
+		else
+		{
+			nulls[Anum_io_rates_flushes] = true;
+			nulls[Anum_io_rates_flush_await] = true;
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 	}
 
-	fclose(diskstats_file);
+	/* The current sample is the previous one of the next call */
+	pfree(previous_disk_stats);
+	previous_disk_stats = current_stats;
+	previous_num_disks = num_disks;
+	previous_disk_sample_time = current_sample_time;
 }
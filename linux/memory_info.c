@@ -9,143 +9,256 @@
 #include "postgres.h"
 #include "system_stats.h"
 
+/*
+ * The keys of /proc/meminfo are mapped to their field with a perfect hash:
+ * the multiplier and the table below were chosen offline so that every
+ * known key lands in a slot of its own. A slot holds the field plus one, 0
+ * meaning no key, and the key is still compared, so keys added by newer
+ * kernels are ignored. The hash is computed while scanning for the colon,
+ * so looking up a key costs no more than finding its end.
+ */
+#define MEMINFO_HASH_MULTIPLIER                  1259
+#define MEMINFO_HASH_BITS                        8
+
+StaticAssertDecl(MEMINFO_NUM_FIELDS == Natts_memory_info_detailed,
+				 "one column per field of /proc/meminfo");
+
+static const uint8 meminfo_slots[1 << MEMINFO_HASH_BITS] = {
+	41,  0,  0,  0,  2,  0,  0,  0,  0, 49,  0, 33,  0,  0, 30,  0,
+	 0, 10,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 47,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	16,  0,  0,  0,  8,  0,  0,  0,  6, 35,  0,  0, 32, 46,  0,  0,
+	 0,  0,  0,  0, 28,  0,  0,  0, 38,  0,  0,  0,  0,  0,  0, 43,
+	13,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0, 50,  0,  0,  0,  0,  0, 53,  4, 56, 36, 45,
+	42,  0,  0, 19, 22,  0,  0,  0, 23, 40,  0,  0,  0,  0,  0,  0,
+	 0,  0, 39,  0, 24,  0,  0,  0,  0, 21,  0, 27,  0,  0,  0,  0,
+	 0, 44,  0,  0,  0,  0,  0, 17,  0, 15, 11, 55, 14,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0, 34,  0,  0,  0, 51,  0,  0, 57,  0,  0,
+	 0,  0,  0,  0,  0, 48,  0,  0,  0,  5, 37,  1,  0,  0,  0,  0,
+	12,  0,  0,  0,  0,  0,  0,  3,  0,  0, 20,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0, 18,  0,  0, 31,  0,  0,  0, 54, 58,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  9,  7,  0,  0,  0,
+	 0,  0,  0, 29,  0,  0, 52, 25,  0,  0,  0, 26,  0,  0,  0,  0,
+};
+
+/* keys of /proc/meminfo in the order of meminfo_field */
+static const char *const meminfo_keys[MEMINFO_NUM_FIELDS] = {
+	"MemTotal",
+	"MemFree",
+	"MemAvailable",
+	"Buffers",
+	"Cached",
+	"SwapCached",
+	"Active",
+	"Inactive",
+	"Active(anon)",
+	"Inactive(anon)",
+	"Active(file)",
+	"Inactive(file)",
+	"Unevictable",
+	"Mlocked",
+	"SwapTotal",
+	"SwapFree",
+	"Zswap",
+	"Zswapped",
+	"Dirty",
+	"Writeback",
+	"AnonPages",
+	"Mapped",
+	"Shmem",
+	"KReclaimable",
+	"Slab",
+	"SReclaimable",
+	"SUnreclaim",
+	"KernelStack",
+	"PageTables",
+	"SecPageTables",
+	"NFS_Unstable",
+	"Bounce",
+	"WritebackTmp",
+	"CommitLimit",
+	"Committed_AS",
+	"VmallocTotal",
+	"VmallocUsed",
+	"VmallocChunk",
+	"Percpu",
+	"HardwareCorrupted",
+	"AnonHugePages",
+	"ShmemHugePages",
+	"ShmemPmdMapped",
+	"FileHugePages",
+	"FilePmdMapped",
+	"CmaTotal",
+	"CmaFree",
+	"Unaccepted",
+	"Balloon",
+	"HugePages_Total",
+	"HugePages_Free",
+	"HugePages_Rsvd",
+	"HugePages_Surp",
+	"Hugepagesize",
+	"Hugetlb",
+	"DirectMap4k",
+	"DirectMap2M",
+	"DirectMap1G",
+};
+
 void ReadMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadMemoryInformationDetailed(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
-void ReadMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+/* Return the field of given key of /proc/meminfo, or -1 if unknown */
+static inline int meminfo_lookup(const char *key, int key_len, uint32 hash)
 {
-	FILE       *memory_file;
-	Datum      values[Natts_memory_info];
-	bool       nulls[Natts_memory_info];
-	char       *line_buf = NULL;
-	size_t     line_buf_size = 0;
-	int        line_count = 0;
-	ssize_t    line_size;
-	uint64     total_memory_bytes = 0;
-	uint64     free_memory_bytes = 0;
-	uint64     used_memory_bytes = 0;
-	uint64     cached_bytes = 0;
-	uint64     swap_total_bytes = 0;
-	uint64     swap_free_bytes = 0;
-	uint64     swap_used_bytes = 0;
+	int slot = meminfo_slots[(hash * 2654435761U) >> (32 - MEMINFO_HASH_BITS)];
 
-	memset(nulls, 0, sizeof(nulls));
+	if (slot == 0)
+		return -1;
 
-	/* Open the file required to read all the memory information */
-	memory_file = fopen(MEMORY_FILE_NAME, "r");
+	if (strncmp(meminfo_keys[slot - 1], key, key_len) != 0 ||
+		meminfo_keys[slot - 1][key_len] != '\0')
+		return -1;
 
-	if (!memory_file)
-	{
-		char memory_file_name[MAXPGPATH];
-		snprintf(memory_file_name, MAXPGPATH, "%s", MEMORY_FILE_NAME);
+	return slot - 1;
+}
 
+/*
+ * Parse /proc/meminfo into given structure in a single pass over the file,
+ * without any allocation. Values reported in kB are converted to bytes.
+ * Returns false if the file can not be read.
+ */
+bool ReadMemInfo(meminfo_stats *stats)
+{
+	char       *content;
+	char       *pos;
+	char       *key;
+	uint32     hash;
+	uint64     value;
+	int        field;
+
+	memset(stats, 0, sizeof(meminfo_stats));
+
+	content = ReadCachedProcFile(MEMORY_FILE_NAME, NULL);
+	if (content == NULL)
+	{
 		ereport(DEBUG1,
-				(errcode_for_file_access(),
-					errmsg("can not open file %s for reading memory information",
-						memory_file_name)));
-		return;
+				(errmsg("can not read file %s for reading memory information",
+					MEMORY_FILE_NAME)));
+		return false;
 	}
 
-	/* Get the first line of the file. */
-	line_size = getline(&line_buf, &line_buf_size, memory_file);
-
-	/* Loop through until we are done with the file. */
-	while (line_size >= 0)
+	for (pos = content; *pos != '\0'; pos++)
 	{
-		/* Read the total memory of the system */
-		char *mem_total = strstr(line_buf, "MemTotal:");
-		char *mem_free = NULL;
-		char *cached_mem = NULL;
-		char *c_swap_total = NULL;
-		char *c_swap_free = NULL;
-		if (mem_total != NULL && mem_total == line_buf)
-		{
-			line_count++;
-			total_memory_bytes = ConvertToBytes(line_buf);
-		}
+		/* Each line is "Key:   value[ kB]" */
+		key = pos;
+		hash = 0;
+		while (*pos != ':' && *pos != '\n' && *pos != '\0')
+			hash = hash * MEMINFO_HASH_MULTIPLIER + (unsigned char) *pos++;
 
-		/* Read the free memory of the system */
-		mem_free = strstr(line_buf, "MemFree:");
-		if (mem_free != NULL && mem_free == line_buf)
+		if (*pos == ':')
 		{
-			line_count++;
-			free_memory_bytes = ConvertToBytes(line_buf);
-		}
+			field = meminfo_lookup(key, pos - key, hash);
 
-		/* Read the cached memory of the system */
-		cached_mem = strstr(line_buf, "Cached:");
-		if (cached_mem != NULL && cached_mem == line_buf)
-		{
-			line_count++;
-			cached_bytes = ConvertToBytes(line_buf);
-		}
+			value = strtoull(pos + 1, &pos, 10);
+			while (*pos == ' ')
+				pos++;
+			if (pos[0] == 'k' && pos[1] == 'B')
+				value *= 1024;
 
-		/* Read the total swap memory of the system */
-		c_swap_total = strstr(line_buf, "SwapTotal:");
-		if (c_swap_total != NULL && c_swap_total == line_buf)
-		{
-			line_count++;
-			swap_total_bytes = ConvertToBytes(line_buf);
+			if (field >= 0)
+			{
+				stats->values[field] = value;
+				stats->present[field] = true;
+			}
 		}
 
-		/* Read the free swap memory of the system */
-		c_swap_free = strstr(line_buf, "SwapFree:");
-		if (c_swap_free != NULL && c_swap_free == line_buf)
-		{
-			line_count++;
-			swap_free_bytes = ConvertToBytes(line_buf);
-		}
+		/* Skip to the end of the line */
+		while (*pos != '\n' && *pos != '\0')
+			pos++;
+		if (*pos == '\0')
+			break;
+	}
 
-		used_memory_bytes = total_memory_bytes - free_memory_bytes;
-		swap_used_bytes = swap_total_bytes - swap_free_bytes;
+	return true;
+}
 
-		// Check if we get all lines, add as row
-		if (line_count == MEMORY_READ_COUNT)
-		{
-			values[Anum_total_memory] = Int64GetDatumFast(total_memory_bytes);
-			values[Anum_free_memory] = Int64GetDatumFast(free_memory_bytes);
-			values[Anum_used_memory] = Int64GetDatumFast(used_memory_bytes);
-			values[Anum_total_cache_memory] = Int64GetDatumFast(cached_bytes);
-			values[Anum_swap_total_memory] = Int64GetDatumFast(swap_total_bytes);
-			values[Anum_swap_free_memory] = Int64GetDatumFast(swap_free_bytes);
-			values[Anum_swap_used_memory] = Int64GetDatumFast(swap_used_bytes);
-
-			/* set the NULL value as it is not for this platform */
-			nulls[Anum_kernel_total_memory] = true;
-			nulls[Anum_kernel_paged_memory] = true;
-			nulls[Anum_kernel_nonpaged_memory] = true;
-			nulls[Anum_total_page_file] = true;
-			nulls[Anum_avail_page_file] = true;
-
-			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
-
-			/* Free the allocated line buffer */
-			if (line_buf != NULL)
-			{
-				free(line_buf);
-				line_buf = NULL;
-			}
+void ReadMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum         values[Natts_memory_info];
+	bool          nulls[Natts_memory_info];
+	meminfo_stats stats;
+	uint64        total_memory_bytes;
+	uint64        free_memory_bytes;
+	uint64        cache_memory_bytes;
+	uint64        swap_total_bytes;
+	uint64        swap_free_bytes;
+	uint64        used_memory_bytes;
+	uint64        swap_used_bytes;
 
-			break;
-		}
+	memset(nulls, 0, sizeof(nulls));
 
-		/* Free the allocated line buffer */
-		if (line_buf != NULL)
-		{
-			free(line_buf);
-			line_buf = NULL;
-		}
+	if (!ReadMemInfo(&stats))
+		return;
 
-		/* Get the next line */
-		line_size = getline(&line_buf, &line_buf_size, memory_file);
+	/* All the fields are needed to add the row */
+	if (!stats.present[MEMINFO_MEM_TOTAL] || !stats.present[MEMINFO_MEM_FREE] ||
+		!stats.present[MEMINFO_CACHED] || !stats.present[MEMINFO_SWAP_TOTAL] ||
+		!stats.present[MEMINFO_SWAP_FREE])
+		return;
+
+	total_memory_bytes = stats.values[MEMINFO_MEM_TOTAL];
+	free_memory_bytes = stats.values[MEMINFO_MEM_FREE];
+	cache_memory_bytes = stats.values[MEMINFO_CACHED];
+	swap_total_bytes = stats.values[MEMINFO_SWAP_TOTAL];
+	swap_free_bytes = stats.values[MEMINFO_SWAP_FREE];
+	used_memory_bytes = total_memory_bytes - free_memory_bytes;
+	swap_used_bytes = swap_total_bytes - swap_free_bytes;
+
+	/* Report the memory of the cgroup of the server if asked to */
+	if (ReadCgroupMemory(&total_memory_bytes, &used_memory_bytes, &cache_memory_bytes,
+						 &swap_total_bytes, &swap_used_bytes))
+	{
+		free_memory_bytes = total_memory_bytes - used_memory_bytes;
+		swap_free_bytes = swap_total_bytes - swap_used_bytes;
 	}
 
-	/* Free the allocated line buffer */
-	if (line_buf != NULL)
+	values[Anum_total_memory] = Int64GetDatumFast(total_memory_bytes);
+	values[Anum_free_memory] = Int64GetDatumFast(free_memory_bytes);
+	values[Anum_used_memory] = Int64GetDatumFast(used_memory_bytes);
+	values[Anum_total_cache_memory] = Int64GetDatumFast(cache_memory_bytes);
+	values[Anum_swap_total_memory] = Int64GetDatumFast(swap_total_bytes);
+	values[Anum_swap_free_memory] = Int64GetDatumFast(swap_free_bytes);
+	values[Anum_swap_used_memory] = Int64GetDatumFast(swap_used_bytes);
+
+	/* set the NULL value as it is not for this platform */
+	nulls[Anum_kernel_total_memory] = true;
+	nulls[Anum_kernel_paged_memory] = true;
+	nulls[Anum_kernel_nonpaged_memory] = true;
+	nulls[Anum_total_page_file] = true;
+	nulls[Anum_avail_page_file] = true;
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
+
+/*
+ * Return all the fields of /proc/meminfo as one row, with NULL for the
+ * fields the running kernel does not report.
+ */
+void ReadMemoryInformationDetailed(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum         values[Natts_memory_info_detailed];
+	bool          nulls[Natts_memory_info_detailed];
+	meminfo_stats stats;
+	int           field;
+
+	if (!ReadMemInfo(&stats))
+		return;
+
+	for (field = 0; field < MEMINFO_NUM_FIELDS; field++)
 	{
-		free(line_buf);
-		line_buf = NULL;
+		values[field] = Int64GetDatumFast(stats.values[field]);
+		nulls[field] = !stats.present[field];
 	}
 
-	/* Close the file now that we are done with it */
-	fclose(memory_file);
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 }
@@ -10,109 +10,133 @@
 #include "postgres.h"
 #include "system_stats.h"
 
+#include "utils/hsearch.h"
+
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <net/if.h>
 #include <netdb.h>
 #include <ifaddrs.h>
 
+/* structure used to store the counters of one interface read from /proc/net/dev */
+typedef struct net_dev_stats
+{
+	char   interface_name[IFNAMSIZ];
+	uint64 rx_bytes;
+	uint64 rx_packets;
+	uint64 rx_errors;
+	uint64 rx_dropped;
+	uint64 tx_bytes;
+	uint64 tx_packets;
+	uint64 tx_errors;
+	uint64 tx_dropped;
+} net_dev_stats;
+
 void ReadFileContent(const char *file_name, uint64 *data);
-void ReadReceiveBytes(const char *interface, uint64 *rx_bytes);
-void ReadTransmitBytes(const char *interface, uint64 *tx_bytes);
-void ReadReceivePackets(const char *interface, uint64 *rx_packets);
-void ReadTransmitPackets(const char *interface, uint64 *tx_packets);
-void ReadReceiveErrors(const char *interface, uint64 *rx_errors);
-void ReadTransmitErrors(const char *interface, uint64 *tx_errors);
-void ReadReceiveDropped(const char *interface, uint64 *rx_dropped);
-void ReadTransmitDropped(const char *interface, uint64 *tx_dropped);
+HTAB *ReadNetDevStatistics(void);
+bool ReadNetDevTotals(uint64 *rx_bytes, uint64 *tx_bytes, uint64 *rx_packets, uint64 *tx_packets);
 void ReadSpeedMbps(const char *interface, uint64 *speed);
 void ReadNetworkInformations(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
-/* This function is used to read the number of bytes received for specified network interface */
-void ReadReceiveBytes(const char *interface, uint64 *rx_bytes)
-{
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
-
-	/* file name used to read the number of bytes received */
-	sprintf(file_name, "/sys/class/net/%s/statistics/rx_bytes", interface);
-	ReadFileContent(file_name, rx_bytes);
-}
-
-/* This function is used to read the number of bytes transmitted for specified network interface */
-void ReadTransmitBytes(const char *interface, uint64 *tx_bytes)
+/*
+ * Read the counters of all interfaces from one read of /proc/net/dev into
+ * a hash table keyed by interface name, instead of reading one sysfs file
+ * per counter and interface. Returns NULL if the file can not be read.
+ */
+HTAB *ReadNetDevStatistics(void)
 {
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
+	HASHCTL        ctl;
+	HTAB           *net_stats;
+	net_dev_stats  *entry;
+	char           *content;
+	char           *line;
+	char           *next_line;
+	char           *colon;
+	char           if_name[IFNAMSIZ];
+	int            line_no = 0;
+	const char     *scan_fmt = UINT64_FORMAT " " UINT64_FORMAT " " UINT64_FORMAT " " UINT64_FORMAT
+		" %*u %*u %*u %*u " UINT64_FORMAT " " UINT64_FORMAT " " UINT64_FORMAT " " UINT64_FORMAT;
+
+	content = ReadCachedProcFile(NET_DEV_STATS_FILE_NAME, NULL);
+	if (content == NULL)
+		return NULL;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = IFNAMSIZ;
+	ctl.entrysize = sizeof(net_dev_stats);
+	ctl.hcxt = CurrentMemoryContext;
+#if PG_VERSION_NUM >= 140000
+	net_stats = hash_create("system_stats network statistics", 64, &ctl,
+							HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+#else
+	/* Keys are hashed as strings by default before PostgreSQL 14 */
+	net_stats = hash_create("system_stats network statistics", 64, &ctl,
+							HASH_ELEM | HASH_CONTEXT);
+#endif
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
 
-	/* file name used to read the number of bytes transmitted */
-	sprintf(file_name, "/sys/class/net/%s/statistics/tx_bytes", interface);
-	ReadFileContent(file_name, tx_bytes);
-}
+		/* The first two lines are the column headers */
+		if (line_no++ < 2)
+			continue;
 
-/* This function is used to read the number of packets received for specified network interface */
-void ReadReceivePackets(const char *interface, uint64 *rx_packets)
-{
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
+		colon = strchr(line, ':');
+		if (colon == NULL)
+			continue;
 
-	/* file name used to read the number of packets received */
-	sprintf(file_name, "/sys/class/net/%s/statistics/rx_packets", interface);
-	ReadFileContent(file_name, rx_packets);
-}
+		*colon = '\0';
+		memset(if_name, 0, IFNAMSIZ);
+		strlcpy(if_name, trimStr(line), IFNAMSIZ);
 
-/* This function is used to read the number of packets transmitted for specified network interface */
-void ReadTransmitPackets(const char *interface, uint64 *tx_packets)
-{
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
+		entry = (net_dev_stats *) hash_search(net_stats, if_name, HASH_ENTER, NULL);
+		if (sscanf(colon + 1, scan_fmt,
+				   &entry->rx_bytes, &entry->rx_packets, &entry->rx_errors, &entry->rx_dropped,
+				   &entry->tx_bytes, &entry->tx_packets, &entry->tx_errors, &entry->tx_dropped) != 8)
+		{
+			ereport(DEBUG1,
+					(errmsg("Error in parsing statistics of interface '%s'", if_name)));
+			(void) hash_search(net_stats, if_name, HASH_REMOVE, NULL);
+		}
+	}
 
-	/* file name used to read the number of packets transmitted */
-	sprintf(file_name, "/sys/class/net/%s/statistics/tx_packets", interface);
-	ReadFileContent(file_name, tx_packets);
+	return net_stats;
 }
 
-/* This function is used to read the number of errors during receiver for specified network interface */
-void ReadReceiveErrors(const char *interface, uint64 *rx_errors)
+/*
+ * Sum the counters of /proc/net/dev over all interfaces but the loopback
+ * one. Returns false if the file can not be read.
+ */
+bool ReadNetDevTotals(uint64 *rx_bytes, uint64 *tx_bytes, uint64 *rx_packets, uint64 *tx_packets)
 {
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
+	HTAB            *net_stats;
+	HASH_SEQ_STATUS status;
+	net_dev_stats   *entry;
 
-	/* file name used to read the number of errors during receiver */
-	sprintf(file_name, "/sys/class/net/%s/statistics/rx_errors", interface);
-	ReadFileContent(file_name, rx_errors);
-}
+	*rx_bytes = *tx_bytes = *rx_packets = *tx_packets = 0;
 
-/* This function is used to read the number of errors during transmission for specified network interface */
-void ReadTransmitErrors(const char *interface, uint64 *tx_errors)
-{
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
-
-	/* file name used to read the number of errors during transmission */
-	sprintf(file_name, "/sys/class/net/%s/statistics/tx_errors", interface);
-	ReadFileContent(file_name, tx_errors);
-}
+	net_stats = ReadNetDevStatistics();
+	if (net_stats == NULL)
+		return false;
 
-/* This function is used to read the number of packets dropped during receiver for specified network interface */
-void ReadReceiveDropped(const char *interface, uint64 *rx_dropped)
-{
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
+	hash_seq_init(&status, net_stats);
+	while ((entry = (net_dev_stats *) hash_seq_search(&status)) != NULL)
+	{
+		if (strcmp(entry->interface_name, "lo") == 0)
+			continue;
 
-	/* file name used to read the number of packets dropped during receiver */
-	sprintf(file_name, "/sys/class/net/%s/statistics/rx_dropped", interface);
-	ReadFileContent(file_name, rx_dropped);
-}
+		*rx_bytes += entry->rx_bytes;
+		*tx_bytes += entry->tx_bytes;
+		*rx_packets += entry->rx_packets;
+		*tx_packets += entry->tx_packets;
+	}
 
-/* This function is used to read the number of packets dropped during transmission for specified network interface */
-void ReadTransmitDropped(const char *interface, uint64 *tx_dropped)
-{
-	char file_name[MAXPGPATH];
-	memset(file_name, 0, MAXPGPATH);
+	hash_destroy(net_stats);
 
-	/* file name used to read the number of packets dropped during transmission */
-	sprintf(file_name, "/sys/class/net/%s/statistics/tx_dropped", interface);
-	ReadFileContent(file_name, tx_dropped);
+	return true;
 }
 
 /* This function is used to read the speed in Mbps for specified network interface */
@@ -133,14 +157,8 @@ void ReadNetworkInformations(Tuplestorestate *tupstore, TupleDesc tupdesc)
 	char       interface_name[MAXPGPATH];
 	char       ipv4_address[MAXPGPATH];
 	uint64     speed_mbps = 0;
-	uint64     tx_bytes = 0;
-	uint64     tx_packets = 0;
-	uint64     tx_errors = 0;
-	uint64     tx_dropped = 0;
-	uint64     rx_bytes = 0;
-	uint64     rx_packets = 0;
-	uint64     rx_errors = 0;
-	uint64     rx_dropped = 0;
+	HTAB       *net_stats;
+	net_dev_stats *if_stats;
 
 	// First find out interface and ip address of that interface
 	struct ifaddrs *ifaddr;
@@ -164,6 +182,14 @@ void ReadNetworkInformations(Tuplestorestate *tupstore, TupleDesc tupdesc)
 		return;
 	}
 
+	/* Read the counters of all interfaces at once */
+	net_stats = ReadNetDevStatistics();
+	if (net_stats == NULL)
+	{
+		freeifaddrs(ifaddr);
+		return;
+	}
+
 	/* Iterate through all network interfaces */
 	for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next)
 	{
@@ -188,26 +214,21 @@ void ReadNetworkInformations(Tuplestorestate *tupstore, TupleDesc tupdesc)
 			memcpy(ipv4_address, host, MAXPGPATH);
 
 			ReadSpeedMbps(interface_name, &speed_mbps);
-			ReadReceiveBytes(interface_name, &rx_bytes);
-			ReadTransmitBytes(interface_name, &tx_bytes);
-			ReadReceivePackets(interface_name, &rx_packets);
-			ReadTransmitPackets(interface_name, &tx_packets);
-			ReadReceiveErrors(interface_name, &rx_errors);
-			ReadTransmitErrors(interface_name, &tx_errors);
-			ReadReceiveDropped(interface_name, &rx_dropped);
-			ReadTransmitDropped(interface_name, &tx_dropped);
 
 			values[Anum_net_interface_name] = CStringGetTextDatum(interface_name);
 			values[Anum_net_ipv4_address] = CStringGetTextDatum(ipv4_address);
 			values[Anum_net_speed_mbps] = Int64GetDatumFast(speed_mbps);
-			values[Anum_net_tx_bytes] = Int64GetDatumFast(tx_bytes);
-			values[Anum_net_tx_packets] = Int64GetDatumFast(tx_packets);
-			values[Anum_net_tx_errors] = Int64GetDatumFast(tx_errors);
-			values[Anum_net_tx_dropped] = Int64GetDatumFast(tx_dropped);
-			values[Anum_net_rx_bytes] = Int64GetDatumFast(rx_bytes);
-			values[Anum_net_rx_packets] = Int64GetDatumFast(rx_packets);
-			values[Anum_net_rx_errors] = Int64GetDatumFast(rx_errors);
-			values[Anum_net_rx_dropped] = Int64GetDatumFast(rx_dropped);
+
+			/* Report zero counters if the interface is missing from /proc/net/dev */
+			if_stats = (net_dev_stats *) hash_search(net_stats, ifa->ifa_name, HASH_FIND, NULL);
+			values[Anum_net_tx_bytes] = Int64GetDatumFast(if_stats ? if_stats->tx_bytes : 0);
+			values[Anum_net_tx_packets] = Int64GetDatumFast(if_stats ? if_stats->tx_packets : 0);
+			values[Anum_net_tx_errors] = Int64GetDatumFast(if_stats ? if_stats->tx_errors : 0);
+			values[Anum_net_tx_dropped] = Int64GetDatumFast(if_stats ? if_stats->tx_dropped : 0);
+			values[Anum_net_rx_bytes] = Int64GetDatumFast(if_stats ? if_stats->rx_bytes : 0);
+			values[Anum_net_rx_packets] = Int64GetDatumFast(if_stats ? if_stats->rx_packets : 0);
+			values[Anum_net_rx_errors] = Int64GetDatumFast(if_stats ? if_stats->rx_errors : 0);
+			values[Anum_net_rx_dropped] = Int64GetDatumFast(if_stats ? if_stats->rx_dropped : 0);
 
 			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 
@@ -215,16 +236,9 @@ void ReadNetworkInformations(Tuplestorestate *tupstore, TupleDesc tupdesc)
 			memset(interface_name, 0, MAXPGPATH);
 			memset(ipv4_address, 0, MAXPGPATH);
 			speed_mbps = 0;
-			tx_bytes = 0;
-			tx_packets = 0;
-			tx_errors = 0;
-			tx_dropped = 0;
-			rx_bytes = 0;
-			rx_packets = 0;
-			rx_errors = 0;
-			rx_dropped = 0;
 		}
 	}
 
+	hash_destroy(net_stats);
 	freeifaddrs(ifaddr);
 }
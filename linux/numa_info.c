@@ -0,0 +1,406 @@
+/*------------------------------------------------------------------------
+ * numa_info.c
+ *              Memory and allocation statistics of the NUMA nodes
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "miscadmin.h"
+
+/* fields of the meminfo file of a node reported by ReadNumaInformation */
+typedef enum numa_meminfo_field
+{
+	NUMA_MEM_TOTAL,
+	NUMA_MEM_FREE,
+	NUMA_MEM_USED,
+	NUMA_FILE_PAGES,
+	NUMA_ANON_PAGES,
+	NUMA_SHMEM,
+	NUMA_NUM_MEMINFO_FIELDS
+} numa_meminfo_field;
+
+/* fields of the numastat file of a node, in the order of their columns */
+typedef enum numa_numastat_field
+{
+	NUMA_HIT,
+	NUMA_MISS,
+	NUMA_FOREIGN,
+	NUMA_INTERLEAVE_HIT,
+	NUMA_LOCAL_NODE,
+	NUMA_OTHER_NODE,
+	NUMA_NUM_NUMASTAT_FIELDS
+} numa_numastat_field;
+
+/* names of the fields, in the order of numa_meminfo_field */
+static const char *const numa_meminfo_keys[NUMA_NUM_MEMINFO_FIELDS] = {
+	"MemTotal",
+	"MemFree",
+	"MemUsed",
+	"FilePages",
+	"AnonPages",
+	"Shmem"
+};
+
+/* names of the fields, in the order of numa_numastat_field */
+static const char *const numa_numastat_keys[NUMA_NUM_NUMASTAT_FIELDS] = {
+	"numa_hit",
+	"numa_miss",
+	"numa_foreign",
+	"interleave_hit",
+	"local_node",
+	"other_node"
+};
+
+/*
+ * Files of the main shared memory segment in numa_maps: an anonymous
+ * shared mapping, with or without huge pages, or a System V segment when
+ * shared_memory_type is sysv.
+ */
+static const char *const shared_memory_files[] = {
+	"file=/dev/zero",
+	"file=/anon_hugepage",
+	"file=/SYSV"
+};
+
+void ReadNumaInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+static int *read_online_nodes(int *num_nodes);
+static bool read_node_meminfo(int node, uint64 *values, bool *present);
+static bool read_node_numastat(int node, uint64 *values, bool *present);
+static bool read_shared_memory_nodes(uint64 *node_bytes, int num_node_ids);
+
+/*
+ * Read the list of the online nodes, such as "0-1,3", into a palloc'd
+ * array sorted by node id. Returns NULL if the kernel has no NUMA support.
+ */
+static int *read_online_nodes(int *num_nodes)
+{
+	char *content;
+	char *pos;
+	char *end;
+	int  *nodes;
+	int  max_nodes = 8;
+	long first;
+	long last;
+	long node;
+
+	*num_nodes = 0;
+
+	content = ReadProcFile(NUMA_NODE_DIRECTORY "/online", NULL);
+	if (content == NULL)
+	{
+		ereport(DEBUG1,
+				(errmsg("can not read file %s/online for reading NUMA information",
+					NUMA_NODE_DIRECTORY)));
+		return NULL;
+	}
+
+	nodes = (int *) palloc(max_nodes * sizeof(int));
+
+	for (pos = content; *pos != '\0' && *pos != '\n'; pos = end)
+	{
+		first = strtol(pos, &end, 10);
+		if (end == pos)
+			break;
+
+		last = first;
+		if (*end == '-')
+		{
+			pos = end + 1;
+			last = strtol(pos, &end, 10);
+			if (end == pos)
+				break;
+		}
+
+		for (node = first; node <= last; node++)
+		{
+			if (*num_nodes == max_nodes)
+			{
+				max_nodes *= 2;
+				nodes = (int *) repalloc(nodes, max_nodes * sizeof(int));
+			}
+			nodes[(*num_nodes)++] = (int) node;
+		}
+
+		if (*end == ',')
+			end++;
+	}
+
+	pfree(content);
+
+	return nodes;
+}
+
+/*
+ * Read the meminfo file of given node, made of "Node <n> <Key>: <value> kB"
+ * lines. The values are returned in bytes.
+ */
+static bool read_node_meminfo(int node, uint64 *values, bool *present)
+{
+	char               file_name[MAXPGPATH];
+	char               key[MIN_BUFFER_SIZE];
+	char               *content;
+	char               *line;
+	char               *next_line;
+	unsigned long long value;
+	int                field;
+
+	memset(present, 0, NUMA_NUM_MEMINFO_FIELDS * sizeof(bool));
+
+	snprintf(file_name, MAXPGPATH, "%s/node%d/meminfo", NUMA_NODE_DIRECTORY, node);
+	content = ReadProcFile(file_name, NULL);
+	if (content == NULL)
+		return false;
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		if (sscanf(line, "Node %*d %127[^:]: %llu", key, &value) != 2)
+			continue;
+
+		for (field = 0; field < NUMA_NUM_MEMINFO_FIELDS; field++)
+		{
+			if (strcmp(key, numa_meminfo_keys[field]) == 0)
+			{
+				values[field] = (uint64) value * 1024;
+				present[field] = true;
+				break;
+			}
+		}
+	}
+
+	pfree(content);
+
+	return true;
+}
+
+/*
+ * Read the numastat file of given node, made of "<key> <value>" lines
+ * counting the pages allocated by the node allocator.
+ */
+static bool read_node_numastat(int node, uint64 *values, bool *present)
+{
+	char               file_name[MAXPGPATH];
+	char               key[MIN_BUFFER_SIZE];
+	char               *content;
+	char               *line;
+	char               *next_line;
+	unsigned long long value;
+	int                field;
+
+	memset(present, 0, NUMA_NUM_NUMASTAT_FIELDS * sizeof(bool));
+
+	snprintf(file_name, MAXPGPATH, "%s/node%d/numastat", NUMA_NODE_DIRECTORY, node);
+	content = ReadProcFile(file_name, NULL);
+	if (content == NULL)
+		return false;
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		if (sscanf(line, "%127s %llu", key, &value) != 2)
+			continue;
+
+		for (field = 0; field < NUMA_NUM_NUMASTAT_FIELDS; field++)
+		{
+			if (strcmp(key, numa_numastat_keys[field]) == 0)
+			{
+				values[field] = (uint64) value;
+				present[field] = true;
+				break;
+			}
+		}
+	}
+
+	pfree(content);
+
+	return true;
+}
+
+/*
+ * Sum the bytes of the main shared memory segment on each node, from the
+ * "N<node>=<pages>" and "kernelpagesize_kB=" fields of its mappings in
+ * /proc/<postmaster>/numa_maps. Only the pages that were touched are
+ * placed on a node. Returns false if the file can not be read.
+ */
+static bool read_shared_memory_nodes(uint64 *node_bytes, int num_node_ids)
+{
+	char               file_name[MAXPGPATH];
+	char               *content;
+	char               *line;
+	char               *next_line;
+	char               *token;
+	char               *saveptr;
+	unsigned long long pages;
+	unsigned long long page_size_kb;
+	int                node;
+	int                index;
+	bool               shared;
+	uint64             *line_pages;
+
+	memset(node_bytes, 0, num_node_ids * sizeof(uint64));
+
+	snprintf(file_name, MAXPGPATH, "%s/%d/numa_maps", PROC_FILE_SYSTEM_PATH, PostmasterPid);
+	content = ReadProcFile(file_name, NULL);
+	if (content == NULL)
+		return false;
+
+	line_pages = (uint64 *) palloc(num_node_ids * sizeof(uint64));
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		shared = false;
+		page_size_kb = 4;
+		memset(line_pages, 0, num_node_ids * sizeof(uint64));
+
+		for (token = strtok_r(line, " ", &saveptr); token != NULL; token = strtok_r(NULL, " ", &saveptr))
+		{
+			if (strncmp(token, "file=", 5) == 0)
+			{
+				for (index = 0; index < lengthof(shared_memory_files); index++)
+				{
+					if (strncmp(token, shared_memory_files[index], strlen(shared_memory_files[index])) == 0)
+						shared = true;
+				}
+			}
+			else if (strncmp(token, "kernelpagesize_kB=", 18) == 0)
+				page_size_kb = strtoull(token + 18, NULL, 10);
+			else if (sscanf(token, "N%d=%llu", &node, &pages) == 2 &&
+					 node >= 0 && node < num_node_ids)
+				line_pages[node] = (uint64) pages;
+		}
+
+		if (!shared)
+			continue;
+
+		for (node = 0; node < num_node_ids; node++)
+			node_bytes[node] += line_pages[node] * page_size_kb * 1024;
+	}
+
+	pfree(line_pages);
+	pfree(content);
+
+	return true;
+}
+
+/*
+ * Report one row per online NUMA node: its memory from the meminfo file
+ * of the node, the allocations of the node allocator from its numastat
+ * file, and the part of the main shared memory segment of the server
+ * placed on the node, read from the numa_maps file of the postmaster.
+ * numa_miss counts the pages allocated on the node while another node was
+ * preferred, and numa_foreign the pages preferred on the node but
+ * allocated on another one. No row is returned when the kernel has no
+ * NUMA support.
+ */
+void ReadNumaInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum  values[Natts_numa_info];
+	bool   nulls[Natts_numa_info];
+	uint64 meminfo[NUMA_NUM_MEMINFO_FIELDS];
+	bool   meminfo_present[NUMA_NUM_MEMINFO_FIELDS];
+	uint64 numastat[NUMA_NUM_NUMASTAT_FIELDS];
+	bool   numastat_present[NUMA_NUM_NUMASTAT_FIELDS];
+	uint64 *shared_bytes;
+	uint64 shared_total = 0;
+	bool   shared_present;
+	int    *nodes;
+	int    num_nodes = 0;
+	int    num_node_ids;
+	int    index;
+	int    field;
+	int    node;
+	char   file_name[MAXPGPATH];
+	char   *cpus;
+
+	nodes = read_online_nodes(&num_nodes);
+	if (nodes == NULL || num_nodes == 0)
+		return;
+
+	/* The list is sorted, so the last node has the highest id */
+	num_node_ids = nodes[num_nodes - 1] + 1;
+	shared_bytes = (uint64 *) palloc(num_node_ids * sizeof(uint64));
+	shared_present = read_shared_memory_nodes(shared_bytes, num_node_ids);
+
+	if (shared_present)
+	{
+		for (node = 0; node < num_node_ids; node++)
+			shared_total += shared_bytes[node];
+	}
+
+	for (index = 0; index < num_nodes; index++)
+	{
+		node = nodes[index];
+		memset(nulls, 0, sizeof(nulls));
+
+		values[Anum_numa_node] = Int32GetDatum(node);
+
+		snprintf(file_name, MAXPGPATH, "%s/node%d/cpulist", NUMA_NODE_DIRECTORY, node);
+		cpus = ReadProcFile(file_name, NULL);
+		if (cpus != NULL)
+		{
+			cpus[strcspn(cpus, "\n")] = '\0';
+			values[Anum_numa_cpus] = CStringGetTextDatum(cpus);
+			pfree(cpus);
+		}
+		else
+			nulls[Anum_numa_cpus] = true;
+
+		if (!read_node_meminfo(node, meminfo, meminfo_present))
+			memset(meminfo_present, 0, sizeof(meminfo_present));
+
+		for (field = 0; field < NUMA_NUM_MEMINFO_FIELDS; field++)
+		{
+			if (meminfo_present[field])
+				values[Anum_numa_mem_total_bytes + field] = Int64GetDatumFast(meminfo[field]);
+			else
+				nulls[Anum_numa_mem_total_bytes + field] = true;
+		}
+
+		if (!read_node_numastat(node, numastat, numastat_present))
+			memset(numastat_present, 0, sizeof(numastat_present));
+
+		for (field = 0; field < NUMA_NUM_NUMASTAT_FIELDS; field++)
+		{
+			if (numastat_present[field])
+				values[Anum_numa_hit + field] = Int64GetDatumFast(numastat[field]);
+			else
+				nulls[Anum_numa_hit + field] = true;
+		}
+
+		if (shared_present)
+		{
+			values[Anum_numa_shared_memory_bytes] = Int64GetDatumFast(shared_bytes[node]);
+			if (shared_total > 0)
+				values[Anum_numa_shared_memory_percent] =
+					Float4GetDatum((float4) (shared_bytes[node] * 100.0 / shared_total));
+			else
+				nulls[Anum_numa_shared_memory_percent] = true;
+		}
+		else
+		{
+			nulls[Anum_numa_shared_memory_bytes] = true;
+			nulls[Anum_numa_shared_memory_percent] = true;
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	pfree(shared_bytes);
+	pfree(nodes);
+}
@@ -0,0 +1,221 @@
+/*------------------------------------------------------------------------
+ * pressure_info.c
+ *              Pressure stall information of the system and cgroup
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "utils/timestamp.h"
+
+/* names of the pressure files, in the order of psi_resource */
+static const char *const psi_resource_names[PSI_NUM_RESOURCES] = {
+	"cpu",
+	"memory",
+	"io"
+};
+
+/* names of the scopes, in the order of psi_scope */
+static const char *const psi_scope_names[PSI_NUM_SCOPES] = {
+	"system",
+	"cgroup"
+};
+
+/* previous sample of this backend, used when the sampler is not running */
+static pressure_sample previous_pressure_sample;
+static bool            previous_pressure_sample_valid = false;
+
+void ReadPressureInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadPressureSample(pressure_sample *sample);
+
+static void read_pressure_file(const char *path, psi_stat *some, psi_stat *full);
+
+/*
+ * Parse one pressure file, made of a "some" line and, except for the CPU
+ * of kernels before 5.13, a "full" line:
+ *
+ *   some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+ *   full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+ *
+ * Lines that are missing or can not be parsed are left marked as absent.
+ */
+static void read_pressure_file(const char *path, psi_stat *some, psi_stat *full)
+{
+	char     *content;
+	char     *line;
+	char     *next_line;
+	psi_stat *stat;
+
+	some->present = false;
+	full->present = false;
+
+	content = ReadCachedProcFile(path, NULL);
+	if (content == NULL)
+		return;
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		if (strncmp(line, "some ", 5) == 0)
+			stat = some;
+		else if (strncmp(line, "full ", 5) == 0)
+			stat = full;
+		else
+			continue;
+
+		if (sscanf(line + 5, "avg10=%f avg60=%f avg300=%f total=" UINT64_FORMAT,
+				   &stat->avg10, &stat->avg60, &stat->avg300, &stat->total_us) == 4)
+			stat->present = true;
+		else
+			ereport(DEBUG1,
+					(errmsg("Error in parsing pressure file %s", path)));
+	}
+}
+
+/*
+ * Read the pressure files of the system from /proc/pressure and, when the
+ * server runs in a cgroup v2 hierarchy, those of its cgroup. The statistics
+ * that are not available are marked as absent.
+ */
+void ReadPressureSample(pressure_sample *sample)
+{
+	char cgroup_dir[MAXPGPATH];
+	char file_name[MAXPGPATH];
+	bool in_cgroup;
+	int  resource;
+
+	memset(sample, 0, sizeof(pressure_sample));
+	sample->sample_time = GetCurrentTimestamp();
+
+	in_cgroup = GetCgroupDirectory(cgroup_dir, MAXPGPATH);
+
+	for (resource = 0; resource < PSI_NUM_RESOURCES; resource++)
+	{
+		snprintf(file_name, MAXPGPATH, "%s/%s", PSI_SYSTEM_DIRECTORY, psi_resource_names[resource]);
+		read_pressure_file(file_name,
+						   &sample->some[PSI_SCOPE_SYSTEM][resource],
+						   &sample->full[PSI_SCOPE_SYSTEM][resource]);
+
+		if (in_cgroup)
+		{
+			snprintf(file_name, MAXPGPATH, "%s/%s.pressure", cgroup_dir, psi_resource_names[resource]);
+			read_pressure_file(file_name,
+							   &sample->some[PSI_SCOPE_CGROUP][resource],
+							   &sample->full[PSI_SCOPE_CGROUP][resource]);
+		}
+	}
+}
+
+/*
+ * Report the pressure stall information of the system and cgroup, one row
+ * per scope and resource. The stall time deltas are computed over the last
+ * interval of the background sampler when it is running, and otherwise
+ * against the previous call of this backend if it is recent enough. The
+ * deltas are NULL when there is nothing to compare with.
+ */
+void ReadPressureInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum           values[Natts_pressure_info];
+	bool            nulls[Natts_pressure_info];
+	pressure_sample current;
+	pressure_sample sampler_first;
+	pressure_sample sampler_second;
+	pressure_sample *first = NULL;
+	pressure_sample *second = NULL;
+	psi_stat        *some;
+	psi_stat        *full;
+	int             scope;
+	int             resource;
+
+	ReadPressureSample(&current);
+
+	if (ReadLatestPressureSamples(&sampler_first, &sampler_second))
+	{
+		first = &sampler_first;
+		second = &sampler_second;
+	}
+	else if (previous_pressure_sample_valid &&
+			 !PreviousSampleExpired(previous_pressure_sample.sample_time))
+	{
+		first = &previous_pressure_sample;
+		second = &current;
+	}
+
+	for (scope = 0; scope < PSI_NUM_SCOPES; scope++)
+	{
+		for (resource = 0; resource < PSI_NUM_RESOURCES; resource++)
+		{
+			some = &current.some[scope][resource];
+			full = &current.full[scope][resource];
+
+			/* The kernel has no pressure information or the server runs in no cgroup */
+			if (!some->present)
+				continue;
+
+			memset(nulls, 0, sizeof(nulls));
+
+			values[Anum_pressure_scope] = CStringGetTextDatum(psi_scope_names[scope]);
+			values[Anum_pressure_resource] = CStringGetTextDatum(psi_resource_names[resource]);
+			values[Anum_pressure_some_avg10] = Float8GetDatum(some->avg10);
+			values[Anum_pressure_some_avg60] = Float8GetDatum(some->avg60);
+			values[Anum_pressure_some_avg300] = Float8GetDatum(some->avg300);
+			values[Anum_pressure_some_total_us] = Int64GetDatumFast(some->total_us);
+
+			if (full->present)
+			{
+				values[Anum_pressure_full_avg10] = Float8GetDatum(full->avg10);
+				values[Anum_pressure_full_avg60] = Float8GetDatum(full->avg60);
+				values[Anum_pressure_full_avg300] = Float8GetDatum(full->avg300);
+				values[Anum_pressure_full_total_us] = Int64GetDatumFast(full->total_us);
+			}
+			else
+			{
+				nulls[Anum_pressure_full_avg10] = true;
+				nulls[Anum_pressure_full_avg60] = true;
+				nulls[Anum_pressure_full_avg300] = true;
+				nulls[Anum_pressure_full_total_us] = true;
+			}
+
+			/* The counters go backwards if the server was moved to another cgroup */
+			if (first != NULL && first->some[scope][resource].present &&
+				second->some[scope][resource].present &&
+				second->some[scope][resource].total_us >= first->some[scope][resource].total_us)
+			{
+				int64  some_delta = second->some[scope][resource].total_us - first->some[scope][resource].total_us;
+				float8 interval_ms = (second->sample_time - first->sample_time) / 1000.0;
+
+				values[Anum_pressure_some_delta_us] = Int64GetDatumFast(some_delta);
+				values[Anum_pressure_delta_interval_ms] = Float8GetDatum(interval_ms);
+
+				if (first->full[scope][resource].present && second->full[scope][resource].present &&
+					second->full[scope][resource].total_us >= first->full[scope][resource].total_us)
+				{
+					int64 full_delta = second->full[scope][resource].total_us - first->full[scope][resource].total_us;
+
+					values[Anum_pressure_full_delta_us] = Int64GetDatumFast(full_delta);
+				}
+				else
+					nulls[Anum_pressure_full_delta_us] = true;
+			}
+			else
+			{
+				nulls[Anum_pressure_some_delta_us] = true;
+				nulls[Anum_pressure_full_delta_us] = true;
+				nulls[Anum_pressure_delta_interval_ms] = true;
+			}
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	/* The current sample is the previous one of the next call */
+	previous_pressure_sample = current;
+	previous_pressure_sample_valid = true;
+}
@@ -0,0 +1,401 @@
+/*------------------------------------------------------------------------
+ * proc_reader.c
+ *              Low level reader of /proc with as few system calls as
+ *              possible per process
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "storage/fd.h"
+#include "utils/memutils.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* pseudo file kept open by the backend, see ReadCachedProcFile */
+typedef struct cached_proc_file
+{
+	char    path[MAXPGPATH];
+	int     fd;
+	uint64  last_used;
+	char    *buf;
+	int     buf_size;
+} cached_proc_file;
+
+static MemoryContext    ProcFileCacheContext = NULL;
+static cached_proc_file proc_file_cache[PROC_FILE_CACHE_SIZE];
+static int              proc_file_cache_used = 0;
+static uint64           proc_file_cache_clock = 0;
+
+/* used for the files read while the cache can not keep them open */
+static cached_proc_file uncached_proc_file;
+
+static cached_proc_file *proc_file_cache_open(const char *path);
+static void proc_file_cache_close(cached_proc_file *entry);
+static int proc_file_cache_read(cached_proc_file *entry);
+
+/* directory entry as returned by getdents64 */
+struct linux_dirent64
+{
+	uint64         d_ino;
+	int64          d_off;
+	unsigned short d_reclen;
+	unsigned char  d_type;
+	char           d_name[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/*
+ * Open given directory for reading its entries in batches. The descriptor
+ * is a transient file of the server, so it is closed at the end of the
+ * transaction if an error is raised before ProcDirClose. Returns false if
+ * the directory can not be opened.
+ */
+bool ProcDirOpen(proc_dir_reader *reader, const char *path)
+{
+	reader->buf_len = 0;
+	reader->buf_pos = 0;
+	reader->dir_fd = OpenTransientFile(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (reader->dir_fd < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+					errmsg("can not open directory %s", path)));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Return the name of the next entry of the directory, other than "." and
+ * "..", or NULL once all entries were read. The entries are fetched with
+ * one getdents64 call per PROC_DIR_READ_BUF_SIZE bytes, instead of one
+ * readdir call per entry.
+ */
+const char *ProcDirNextEntry(proc_dir_reader *reader)
+{
+	struct linux_dirent64 *dirent;
+
+	for (;;)
+	{
+		if (reader->buf_pos >= reader->buf_len)
+		{
+			long nread = syscall(SYS_getdents64, reader->dir_fd, reader->buf.data, PROC_DIR_READ_BUF_SIZE);
+
+			if (nread <= 0)
+				return NULL;
+
+			reader->buf_len = (int) nread;
+			reader->buf_pos = 0;
+		}
+
+		dirent = (struct linux_dirent64 *) (reader->buf.data + reader->buf_pos);
+		reader->buf_pos += dirent->d_reclen;
+
+		if (strcmp(dirent->d_name, ".") != 0 && strcmp(dirent->d_name, "..") != 0)
+			return dirent->d_name;
+	}
+}
+
+/*
+ * Return the name of the next entry of the directory made only of digits,
+ * such as a process or thread id, or NULL once all entries were read.
+ */
+const char *ProcDirNextNumericEntry(proc_dir_reader *reader)
+{
+	const char *name;
+
+	while ((name = ProcDirNextEntry(reader)) != NULL)
+	{
+		if (isdigit((unsigned char) name[0]))
+			return name;
+	}
+
+	return NULL;
+}
+
+void ProcDirClose(proc_dir_reader *reader)
+{
+	if (reader->dir_fd >= 0)
+		CloseTransientFile(reader->dir_fd);
+
+	reader->dir_fd = -1;
+}
+
+/*
+ * Read the content of a file relative to given directory into buf with one
+ * pread, and terminate it with a NUL character. Files of /proc are
+ * generated in one go by the kernel, so one read returns the whole content
+ * as long as buf is large enough. Returns the number of bytes read, or -1
+ * if the file can not be read, e.g. because the process exited.
+ */
+int ReadProcFileAt(int dir_fd, const char *path, char *buf, int buf_size)
+{
+	int     fd;
+	ssize_t nread;
+
+	fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	nread = pread(fd, buf, buf_size - 1, 0);
+	close(fd);
+
+	if (nread < 0)
+		return -1;
+
+	buf[nread] = '\0';
+
+	return (int) nread;
+}
+
+/*
+ * Read the whole content of given file into a palloc'd buffer terminated
+ * with a NUL character, for files such as /proc/net/dev whose size grows
+ * with the number of devices. Returns NULL if the file can not be read.
+ */
+char *ReadProcFile(const char *path, int *len)
+{
+	int     fd;
+	char    *buf;
+	int     buf_size = PROC_FILE_INITIAL_BUF_SIZE;
+	int     buf_len = 0;
+	ssize_t nread;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+					errmsg("can not open file %s for reading", path)));
+		return NULL;
+	}
+
+	buf = (char *) palloc(buf_size);
+
+	for (;;)
+	{
+		if (buf_len >= buf_size - 1)
+		{
+			buf_size *= 2;
+			buf = (char *) repalloc(buf, buf_size);
+		}
+
+		nread = read(fd, buf + buf_len, buf_size - buf_len - 1);
+		if (nread < 0 && errno == EINTR)
+			continue;
+		if (nread <= 0)
+			break;
+
+		buf_len += nread;
+	}
+
+	close(fd);
+
+	if (nread < 0)
+	{
+		pfree(buf);
+		return NULL;
+	}
+
+	buf[buf_len] = '\0';
+
+	if (len != NULL)
+		*len = buf_len;
+
+	return buf;
+}
+
+/*
+ * Open given file and add it to the cache, in a slot left empty by a file
+ * that went away if there is one, otherwise evicting the least recently
+ * used file if the cache is full. The descriptors are accounted as external
+ * file descriptors, so the cache never takes descriptors the backend may
+ * need. Returns the uncached entry if no descriptor can be kept, and NULL
+ * if the file can not be opened.
+ */
+static cached_proc_file *proc_file_cache_open(const char *path)
+{
+	cached_proc_file *entry = NULL;
+	int              index;
+
+	if (ProcFileCacheContext == NULL)
+		ProcFileCacheContext = AllocSetContextCreate(TopMemoryContext,
+													 "system_stats file cache",
+													 ALLOCSET_SMALL_SIZES);
+
+	/* A slot emptied by ReadCachedProcFile is reused before evicting a file */
+	for (index = 0; index < proc_file_cache_used; index++)
+	{
+		if (proc_file_cache[index].fd < 0)
+		{
+			entry = &proc_file_cache[index];
+			break;
+		}
+	}
+
+	if (entry == NULL && proc_file_cache_used < PROC_FILE_CACHE_SIZE)
+		entry = &proc_file_cache[proc_file_cache_used++];
+	else if (entry == NULL)
+	{
+		entry = &proc_file_cache[0];
+		for (index = 1; index < PROC_FILE_CACHE_SIZE; index++)
+		{
+			if (proc_file_cache[index].last_used < entry->last_used)
+				entry = &proc_file_cache[index];
+		}
+
+		proc_file_cache_close(entry);
+	}
+
+	if (!AcquireExternalFD())
+	{
+		/* Leave the slot empty, it is reused by the next file opened */
+		entry->fd = -1;
+		entry->path[0] = '\0';
+		entry->last_used = 0;
+		entry = &uncached_proc_file;
+	}
+
+	entry->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (entry->fd < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+					errmsg("can not open file %s for reading", path)));
+
+		if (entry != &uncached_proc_file)
+		{
+			ReleaseExternalFD();
+			entry->path[0] = '\0';
+			entry->last_used = 0;
+		}
+		return NULL;
+	}
+
+	strlcpy(entry->path, path, MAXPGPATH);
+
+	if (entry->buf == NULL)
+	{
+		entry->buf_size = PROC_FILE_INITIAL_BUF_SIZE;
+		entry->buf = (char *) MemoryContextAlloc(ProcFileCacheContext, entry->buf_size);
+	}
+
+	return entry;
+}
+
+/* Close the file of given entry, keeping its buffer for the next file */
+static void proc_file_cache_close(cached_proc_file *entry)
+{
+	if (entry->fd >= 0)
+	{
+		close(entry->fd);
+		if (entry != &uncached_proc_file)
+			ReleaseExternalFD();
+	}
+
+	entry->fd = -1;
+	entry->path[0] = '\0';
+}
+
+/*
+ * Read the whole file of given entry from offset 0 into its buffer, growing
+ * it as needed. Files made of one record per line or device, such as
+ * /proc/net/dev or /proc/vmstat, return about a page per read, so the file
+ * is read at increasing offsets until end of file. Returns the number of
+ * bytes read, or -1.
+ */
+static int proc_file_cache_read(cached_proc_file *entry)
+{
+	ssize_t nread;
+	int     len = 0;
+
+	for (;;)
+	{
+		if (len >= entry->buf_size - 1)
+		{
+			entry->buf_size *= 2;
+			entry->buf = (char *) repalloc(entry->buf, entry->buf_size);
+		}
+
+		nread = pread(entry->fd, entry->buf + len, entry->buf_size - len - 1, len);
+		if (nread < 0 && errno == EINTR)
+			continue;
+		if (nread <= 0)
+			break;
+
+		len += nread;
+	}
+
+	if (nread < 0)
+		return -1;
+
+	entry->buf[len] = '\0';
+
+	return len;
+}
+
+/*
+ * Read the whole content of given pseudo file of /proc or /sys through a
+ * file descriptor kept open by the backend across calls. Reading from
+ * offset 0 makes the kernel generate the content again, so polling a file
+ * costs neither an open and close pair nor a stdio buffer. The returned
+ * buffer belongs to the cache and is only valid until the next call; the
+ * caller may modify it. Returns NULL if the file can not be read.
+ *
+ * A file whose device or interface went away fails with ENODEV or ENOENT,
+ * and is then opened again, so a device that was replaced is picked up and
+ * one that was removed leaves the cache.
+ */
+char *ReadCachedProcFile(const char *path, int *len)
+{
+	cached_proc_file *entry = NULL;
+	int              nread;
+	int              index;
+
+	for (index = 0; index < proc_file_cache_used; index++)
+	{
+		if (proc_file_cache[index].fd >= 0 && strcmp(proc_file_cache[index].path, path) == 0)
+		{
+			entry = &proc_file_cache[index];
+			break;
+		}
+	}
+
+	if (entry == NULL && (entry = proc_file_cache_open(path)) == NULL)
+		return NULL;
+
+	entry->last_used = ++proc_file_cache_clock;
+
+	nread = proc_file_cache_read(entry);
+	if (nread < 0 && entry != &uncached_proc_file &&
+		(errno == ENODEV || errno == ENOENT || errno == ESTALE))
+	{
+		/* The file is opened again in the emptied slot, evicting no other file */
+		proc_file_cache_close(entry);
+		if ((entry = proc_file_cache_open(path)) == NULL)
+			return NULL;
+
+		entry->last_used = proc_file_cache_clock;
+		nread = proc_file_cache_read(entry);
+	}
+
+	if (entry == &uncached_proc_file)
+		proc_file_cache_close(entry);
+
+	if (nread < 0)
+		return NULL;
+
+	if (len != NULL)
+		*len = nread;
+
+	return entry->buf;
+}
@@ -0,0 +1,329 @@
+/*------------------------------------------------------------------------
+ * process_snapshot.c
+ *              Single pass snapshot of /proc shared by all process
+ *              based collectors
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "access/xact.h"
+#include "common/hashfn.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define PROCESS_SNAPSHOT_INITIAL_SIZE           1024
+#define PROCESS_SNAPSHOT_MIN_SIZE               16
+/* age after which the snapshot of the statement is taken again */
+#define PROCESS_SNAPSHOT_MAX_AGE_MS             1000
+
+/* snapshot taken by the current statement, see GetStatementProcessSnapshot */
+static MemoryContext    StatementSnapshotContext = NULL;
+static process_snapshot *statement_snapshot = NULL;
+static TimestampTz      statement_snapshot_start = 0;
+
+static void process_snapshot_init(process_snapshot *snapshot, int initial_size);
+static bool read_process_stat(int proc_fd, const char *pid_name, process_stat *entry);
+static bool parse_process_stat(char *stat_buf, process_stat *entry);
+static process_stat *process_snapshot_insert(process_snapshot *snapshot, int pid, unsigned long long start_time);
+
+/* Compute the slot where the lookup for given pid and start time begins */
+static inline uint32 process_snapshot_hash(int pid, unsigned long long start_time)
+{
+	return hash_combine(hash_bytes_uint32((uint32) pid),
+						hash_bytes_uint32((uint32) (start_time ^ (start_time >> 32))));
+}
+
+/* Allocate an empty snapshot, initial_size must be a power of two */
+static void process_snapshot_init(process_snapshot *snapshot, int initial_size)
+{
+	snapshot->max_entries = initial_size;
+	snapshot->entries = (process_stat *) palloc(snapshot->max_entries * sizeof(process_stat));
+	snapshot->num_slots = initial_size * 2;
+	snapshot->slots = (int *) palloc0(snapshot->num_slots * sizeof(int));
+	snapshot->snapshot_time = GetCurrentTimestamp();
+	snapshot->total_cpu_ticks = ReadTotalCPUUsage();
+}
+
+/*
+ * Read /proc/<pid>/stat of given process into entry, relative to the file
+ * descriptor of /proc. Returns false if the process does not exist, e.g.
+ * because it exited, or if the file can not be parsed.
+ */
+static bool read_process_stat(int proc_fd, const char *pid_name, process_stat *entry)
+{
+	char file_name[MIN_BUFFER_SIZE];
+	char stat_buf[MAX_BUFFER_SIZE];
+
+	snprintf(file_name, MIN_BUFFER_SIZE, "%s/stat", pid_name);
+
+	if (ReadProcFileAt(proc_fd, file_name, stat_buf, MAX_BUFFER_SIZE) < 0)
+		return false;
+
+	if (!parse_process_stat(stat_buf, entry))
+	{
+		ereport(DEBUG1, (errmsg("Error in parsing file '/proc/%s'", file_name)));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Parse the content of /proc/<pid>/stat into given entry. The process name
+ * may contain spaces and parentheses, so it is delimited by the first '('
+ * and the last ')' of the line.
+ */
+static bool parse_process_stat(char *stat_buf, process_stat *entry)
+{
+	char   *name_start = strchr(stat_buf, '(');
+	char   *name_end = strrchr(stat_buf, ')');
+	int    name_len;
+
+	if (name_start == NULL || name_end == NULL || name_end < name_start)
+		return false;
+
+	entry->pid = atoi(stat_buf);
+
+	/* keep the parentheses around the name as reported by the kernel */
+	name_len = Min(name_end - name_start + 1, PROCESS_NAME_LEN - 1);
+	memcpy(entry->name, name_start, name_len);
+	entry->name[name_len] = '\0';
+
+	if (sscanf(name_end + 1, " %c %d %*d %*d %*d %*d %*u %llu %*u %llu %*u %llu %llu"
+			   " %*d %*d %*d %*d %d %*d %llu %*u %llu",
+			   &entry->state, &entry->ppid, &entry->minor_faults, &entry->major_faults,
+			   &entry->utime_ticks, &entry->stime_ticks,
+			   &entry->num_threads, &entry->start_time, &entry->rss_pages) != 9)
+		return false;
+
+	entry->cpu_ticks = entry->utime_ticks + entry->stime_ticks;
+
+	return true;
+}
+
+/* Add a new entry for given process, growing the table when half full */
+static process_stat *process_snapshot_insert(process_snapshot *snapshot, int pid, unsigned long long start_time)
+{
+	process_stat *entry;
+	uint32       mask;
+	uint32       slot;
+
+	if (snapshot->num_entries >= snapshot->max_entries)
+	{
+		int index;
+
+		snapshot->max_entries *= 2;
+		snapshot->entries = (process_stat *) repalloc(snapshot->entries,
+													  snapshot->max_entries * sizeof(process_stat));
+
+		/* Rebuild the slots so the table never gets more than half full */
+		pfree(snapshot->slots);
+		snapshot->num_slots = snapshot->max_entries * 2;
+		snapshot->slots = (int *) palloc0(snapshot->num_slots * sizeof(int));
+		mask = snapshot->num_slots - 1;
+
+		for (index = 0; index < snapshot->num_entries; index++)
+		{
+			slot = process_snapshot_hash(snapshot->entries[index].pid,
+										 snapshot->entries[index].start_time) & mask;
+			while (snapshot->slots[slot] != 0)
+				slot = (slot + 1) & mask;
+			snapshot->slots[slot] = index + 1;
+		}
+	}
+
+	mask = snapshot->num_slots - 1;
+	slot = process_snapshot_hash(pid, start_time) & mask;
+	while (snapshot->slots[slot] != 0)
+		slot = (slot + 1) & mask;
+
+	entry = &snapshot->entries[snapshot->num_entries++];
+	snapshot->slots[slot] = snapshot->num_entries;
+
+	return entry;
+}
+
+/*
+ * Read /proc/<pid>/stat of every process once into given snapshot. Returns
+ * false if /proc can not be read.
+ */
+bool TakeProcessSnapshot(process_snapshot *snapshot)
+{
+	proc_dir_reader reader;
+	const char      *pid_name;
+	process_stat    entry;
+
+	memset(snapshot, 0, sizeof(process_snapshot));
+
+	if (!ProcDirOpen(&reader, PROC_FILE_SYSTEM_PATH))
+		return false;
+
+	process_snapshot_init(snapshot, PROCESS_SNAPSHOT_INITIAL_SIZE);
+
+	/* Iterate only digit as name because it is process id */
+	while ((pid_name = ProcDirNextNumericEntry(&reader)) != NULL)
+	{
+		if (read_process_stat(reader.dir_fd, pid_name, &entry))
+			*process_snapshot_insert(snapshot, entry.pid, entry.start_time) = entry;
+	}
+
+	ProcDirClose(&reader);
+
+	return true;
+}
+
+/*
+ * Read /proc/<pid>/stat of the given processes only into given snapshot,
+ * without walking /proc. Processes that do not exist are left out. Returns
+ * false if /proc can not be opened.
+ */
+bool TakeProcessSnapshotOfPids(process_snapshot *snapshot, const int *pids, int num_pids)
+{
+	int          proc_fd;
+	int          initial_size = PROCESS_SNAPSHOT_MIN_SIZE;
+	char         pid_name[MIN_BUFFER_SIZE];
+	process_stat entry;
+	int          index;
+
+	memset(snapshot, 0, sizeof(process_snapshot));
+
+	proc_fd = open(PROC_FILE_SYSTEM_PATH, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (proc_fd < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+					errmsg("can not open directory %s", PROC_FILE_SYSTEM_PATH)));
+		return false;
+	}
+
+	while (initial_size < num_pids)
+		initial_size *= 2;
+
+	process_snapshot_init(snapshot, initial_size);
+
+	for (index = 0; index < num_pids; index++)
+	{
+		snprintf(pid_name, MIN_BUFFER_SIZE, "%d", pids[index]);
+
+		if (read_process_stat(proc_fd, pid_name, &entry))
+			*process_snapshot_insert(snapshot, entry.pid, entry.start_time) = entry;
+	}
+
+	close(proc_fd);
+
+	return true;
+}
+
+/*
+ * Read /proc/<pid>/task/<tid>/stat of every thread of given process into
+ * given snapshot, keyed by thread id and start time. Returns false if the
+ * process does not exist.
+ */
+bool TakeThreadSnapshot(process_snapshot *snapshot, int pid)
+{
+	proc_dir_reader reader;
+	const char      *tid_name;
+	char            path[MAXPGPATH];
+	process_stat    entry;
+
+	memset(snapshot, 0, sizeof(process_snapshot));
+
+	snprintf(path, MAXPGPATH, "%s/%d/task", PROC_FILE_SYSTEM_PATH, pid);
+	if (!ProcDirOpen(&reader, path))
+		return false;
+
+	process_snapshot_init(snapshot, PROCESS_SNAPSHOT_MIN_SIZE);
+
+	while ((tid_name = ProcDirNextNumericEntry(&reader)) != NULL)
+	{
+		if (read_process_stat(reader.dir_fd, tid_name, &entry))
+			*process_snapshot_insert(snapshot, entry.pid, entry.start_time) = entry;
+	}
+
+	ProcDirClose(&reader);
+
+	return true;
+}
+
+/* Find the entry of given process, returns NULL if not found */
+process_stat *LookupProcessSnapshot(process_snapshot *snapshot, int pid, unsigned long long start_time)
+{
+	uint32 mask = snapshot->num_slots - 1;
+	uint32 slot = process_snapshot_hash(pid, start_time) & mask;
+
+	while (snapshot->slots[slot] != 0)
+	{
+		process_stat *entry = &snapshot->entries[snapshot->slots[slot] - 1];
+
+		if (entry->pid == pid && entry->start_time == start_time)
+			return entry;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return NULL;
+}
+
+void FreeProcessSnapshot(process_snapshot *snapshot)
+{
+	if (snapshot->entries != NULL)
+		pfree(snapshot->entries);
+	if (snapshot->slots != NULL)
+		pfree(snapshot->slots);
+
+	snapshot->entries = NULL;
+	snapshot->slots = NULL;
+	snapshot->num_entries = 0;
+}
+
+/*
+ * Return the process snapshot of the current statement, taking it on first
+ * use. All the process based functions called by one statement, such as a
+ * dashboard query joining pg_sys_os_info() and pg_sys_process_info(), share
+ * a single walk of /proc. A statement running for longer, such as a
+ * PL/pgSQL loop or a procedure calling these functions repeatedly, takes a
+ * new snapshot once the previous one is PROCESS_SNAPSHOT_MAX_AGE_MS old.
+ * Returns NULL if /proc can not be read.
+ */
+process_snapshot *GetStatementProcessSnapshot(void)
+{
+	TimestampTz      statement_start = GetCurrentStatementStartTimestamp();
+	MemoryContext    oldcontext;
+	process_snapshot *snapshot;
+
+	if (statement_snapshot != NULL && statement_snapshot_start == statement_start &&
+		!TimestampDifferenceExceeds(statement_snapshot->snapshot_time, GetCurrentTimestamp(),
+									PROCESS_SNAPSHOT_MAX_AGE_MS))
+		return statement_snapshot;
+
+	if (StatementSnapshotContext == NULL)
+		StatementSnapshotContext = AllocSetContextCreate(TopMemoryContext,
+														 "system_stats process snapshot",
+														 ALLOCSET_DEFAULT_SIZES);
+	else
+		MemoryContextReset(StatementSnapshotContext);
+
+	statement_snapshot = NULL;
+
+	oldcontext = MemoryContextSwitchTo(StatementSnapshotContext);
+	snapshot = (process_snapshot *) palloc(sizeof(process_snapshot));
+	if (!TakeProcessSnapshot(snapshot))
+		snapshot = NULL;
+	MemoryContextSwitchTo(oldcontext);
+
+	if (snapshot != NULL)
+	{
+		statement_snapshot = snapshot;
+		statement_snapshot_start = statement_start;
+	}
+
+	return snapshot;
+}
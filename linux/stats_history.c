@@ -0,0 +1,692 @@
+/*------------------------------------------------------------------------
+ * stats_history.c
+ *              History of system statistics kept by the background
+ *              sampler in a memory mapped ring file
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "port/atomics.h"
+#include "port/pg_crc32c.h"
+#include "storage/fd.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* flags of history_record telling which counters could be read */
+#define HISTORY_HAS_CPU                          0x01
+#define HISTORY_HAS_MEMORY                       0x02
+#define HISTORY_HAS_LOAD                         0x04
+#define HISTORY_HAS_DISK                         0x08
+#define HISTORY_HAS_NETWORK                      0x10
+
+/*
+ * One sample of the history. The counters are stored as read, the rates
+ * are computed when the history is scanned. seq is the position of the
+ * record in the history starting at 1, so a slot never written is not
+ * valid, and crc covers the whole record so a record torn by a crash or
+ * being overwritten while read is detected.
+ */
+typedef struct history_record
+{
+	uint64          seq;
+	TimestampTz     sample_time;
+	struct cpu_stat cpu;
+	uint64          total_memory;
+	uint64          free_memory;
+	uint64          available_memory;
+	uint64          cached_memory;
+	uint64          swap_total_memory;
+	uint64          swap_free_memory;
+	uint64          disk_reads;
+	uint64          disk_writes;
+	uint64          disk_read_bytes;
+	uint64          disk_write_bytes;
+	uint64          net_rx_bytes;
+	uint64          net_tx_bytes;
+	uint64          net_rx_packets;
+	uint64          net_tx_packets;
+	float4          load_avg_one_minute;
+	float4          load_avg_five_minutes;
+	float4          load_avg_fifteen_minutes;
+	uint32          flags;
+	pg_crc32c       crc;
+} history_record;
+
+/*
+ * Header at the start of the file, followed by capacity records. next_seq
+ * is only a hint for the readers, the writer finds the last record from
+ * the records themselves when it opens the file.
+ */
+typedef struct history_file_header
+{
+	uint32          magic;
+	uint32          version;
+	uint32          record_size;
+	uint32          capacity;
+	uint64          next_seq;
+} history_file_header;
+
+#define HISTORY_HEADER_SIZE     MAXALIGN(sizeof(history_file_header))
+#define HISTORY_RECORD(base, capacity, seq) \
+	((history_record *) ((base) + HISTORY_HEADER_SIZE) + ((seq) - 1) % (capacity))
+
+/* memory mapping of the history file */
+typedef struct history_map
+{
+	char            *base;
+	Size            size;
+	dev_t           dev;
+	ino_t           ino;
+} history_map;
+
+/* number of records kept in the history, 0 disables it */
+static int history_size = HISTORY_DEFAULT_SIZE;
+
+/* interval between two records of the history, in milliseconds */
+static int history_interval_ms = HISTORY_DEFAULT_INTERVAL_MS;
+
+/* state of the writer, in the background sampler */
+static history_file_header *writer_header = NULL;
+static char                *writer_base = NULL;
+static TimestampTz         last_history_time = 0;
+static MemoryContext       HistorySampleContext = NULL;
+
+/* mapping of the readers, kept across calls of the backend */
+static history_map reader_map = {NULL, 0, 0, 0};
+
+static bool history_open_writer(void);
+static void collect_history_record(history_record *record);
+static bool read_history_record(char *base, uint32 capacity, uint64 seq, history_record *record);
+static bool history_map_file(history_map *map);
+static void put_history_row(Tuplestorestate *tupstore, TupleDesc tupdesc,
+							history_record *record, history_record *previous);
+
+/* Define the GUCs of the history, called by InitSystemStatsSampler at preload */
+void InitSystemStatsHistory(void)
+{
+	DefineCustomIntVariable("system_stats.history_size",
+							"Sets the number of samples kept in the history file, 0 disables the history.",
+							NULL,
+							&history_size,
+							HISTORY_DEFAULT_SIZE,
+							0,
+							(int) (INT_MAX / sizeof(history_record)),
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("system_stats.history_interval",
+							"Sets the interval between two samples of the history.",
+							NULL,
+							&history_interval_ms,
+							HISTORY_DEFAULT_INTERVAL_MS,
+							1000,
+							86400000,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+}
+
+/* Compute the checksum of given record, not including the checksum itself */
+static pg_crc32c history_record_crc(history_record *record)
+{
+	pg_crc32c crc;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, record, offsetof(history_record, crc));
+	FIN_CRC32C(crc);
+
+	return crc;
+}
+
+/*
+ * Open the history file and map it in memory, then find the last record
+ * written before the sampler stopped. A file that does not match the
+ * configured size is replaced by a new one, made under another name and
+ * renamed, so backends which still map the previous file keep reading it
+ * safely. Returns false if the history can not be written.
+ */
+static bool history_open_writer(void)
+{
+	Size                file_size = HISTORY_HEADER_SIZE + (Size) history_size * sizeof(history_record);
+	int                 fd;
+	struct stat         st;
+	history_file_header *header = NULL;
+	history_record      record;
+	uint64              last_seq = 0;
+	uint32              slot;
+
+	fd = OpenTransientFile(HISTORY_FILE_NAME, O_RDWR | PG_BINARY);
+	if (fd >= 0)
+	{
+		if (fstat(fd, &st) == 0 && st.st_size == file_size)
+		{
+			writer_base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (writer_base == MAP_FAILED)
+				writer_base = NULL;
+		}
+		CloseTransientFile(fd);
+	}
+
+	if (writer_base != NULL)
+	{
+		header = (history_file_header *) writer_base;
+
+		/* A file of the same size may still be made for another layout */
+		if (header->magic != HISTORY_FILE_MAGIC || header->version != HISTORY_FILE_VERSION ||
+			header->record_size != sizeof(history_record) || header->capacity != history_size)
+		{
+			munmap(writer_base, file_size);
+			writer_base = NULL;
+		}
+	}
+
+	if (writer_base == NULL)
+	{
+		fd = OpenTransientFile(HISTORY_TEMP_FILE_NAME, O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+		if (fd < 0)
+		{
+			ereport(WARNING,
+					(errcode_for_file_access(),
+						errmsg("could not create history file \"%s\": %m", HISTORY_TEMP_FILE_NAME)));
+			return false;
+		}
+
+		if (ftruncate(fd, file_size) == 0)
+		{
+			writer_base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (writer_base == MAP_FAILED)
+				writer_base = NULL;
+		}
+		CloseTransientFile(fd);
+
+		if (writer_base == NULL)
+		{
+			ereport(WARNING,
+					(errcode_for_file_access(),
+						errmsg("could not map history file \"%s\": %m", HISTORY_TEMP_FILE_NAME)));
+			unlink(HISTORY_TEMP_FILE_NAME);
+			return false;
+		}
+
+		header = (history_file_header *) writer_base;
+		header->magic = HISTORY_FILE_MAGIC;
+		header->version = HISTORY_FILE_VERSION;
+		header->record_size = sizeof(history_record);
+		header->capacity = history_size;
+		header->next_seq = 1;
+
+		if (rename(HISTORY_TEMP_FILE_NAME, HISTORY_FILE_NAME) < 0)
+		{
+			ereport(WARNING,
+					(errcode_for_file_access(),
+						errmsg("could not rename history file \"%s\" to \"%s\": %m",
+							HISTORY_TEMP_FILE_NAME, HISTORY_FILE_NAME)));
+			munmap(writer_base, file_size);
+			writer_base = NULL;
+			unlink(HISTORY_TEMP_FILE_NAME);
+			return false;
+		}
+
+		ereport(LOG,
+				(errmsg("system_stats history file \"%s\" created for %d samples",
+					HISTORY_FILE_NAME, history_size)));
+	}
+
+	/*
+	 * The header may lag behind the records after a crash, so the last
+	 * record is the valid one with the highest position. A torn record is
+	 * simply overwritten.
+	 */
+	for (slot = 0; slot < header->capacity; slot++)
+	{
+		memcpy(&record, (history_record *) (writer_base + HISTORY_HEADER_SIZE) + slot, sizeof(history_record));
+
+		if (record.seq != 0 && (record.seq - 1) % header->capacity == slot &&
+			EQ_CRC32C(record.crc, history_record_crc(&record)) && record.seq > last_seq)
+			last_seq = record.seq;
+	}
+
+	header->next_seq = last_seq + 1;
+	writer_header = header;
+
+	return true;
+}
+
+/* Read the counters of one record of the history */
+static void collect_history_record(history_record *record)
+{
+	meminfo_stats stats;
+
+	memset(record, 0, sizeof(history_record));
+
+	record->sample_time = GetCurrentTimestamp();
+
+	cpu_stat_information(&record->cpu);
+	if (record->cpu.usermode_normal_process != 0 || record->cpu.idle_mode != 0)
+		record->flags |= HISTORY_HAS_CPU;
+
+	if (ReadMemInfo(&stats) && stats.present[MEMINFO_MEM_TOTAL])
+	{
+		record->total_memory = stats.values[MEMINFO_MEM_TOTAL];
+		record->free_memory = stats.values[MEMINFO_MEM_FREE];
+		record->available_memory = stats.values[MEMINFO_MEM_AVAILABLE];
+		record->cached_memory = stats.values[MEMINFO_CACHED];
+		record->swap_total_memory = stats.values[MEMINFO_SWAP_TOTAL];
+		record->swap_free_memory = stats.values[MEMINFO_SWAP_FREE];
+		record->flags |= HISTORY_HAS_MEMORY;
+	}
+
+	if (ReadLoadAverages(&record->load_avg_one_minute, &record->load_avg_five_minutes,
+						 &record->load_avg_fifteen_minutes))
+		record->flags |= HISTORY_HAS_LOAD;
+
+	if (ReadDiskIOTotals(&record->disk_reads, &record->disk_writes,
+						 &record->disk_read_bytes, &record->disk_write_bytes))
+		record->flags |= HISTORY_HAS_DISK;
+
+	if (ReadNetDevTotals(&record->net_rx_bytes, &record->net_tx_bytes,
+						 &record->net_rx_packets, &record->net_tx_packets))
+		record->flags |= HISTORY_HAS_NETWORK;
+}
+
+/*
+ * Append a record to the history if the history interval has elapsed since
+ * the previous one. Called by the background sampler on each of its ticks.
+ */
+void TakeHistorySample(void)
+{
+	history_record record;
+	MemoryContext  oldcontext;
+
+	if (history_size == 0)
+		return;
+
+	if (last_history_time != 0 &&
+		!TimestampDifferenceExceeds(last_history_time, GetCurrentTimestamp(), history_interval_ms))
+		return;
+
+	if (writer_header == NULL)
+	{
+		/* Do not retry on every tick if the file can not be used */
+		last_history_time = GetCurrentTimestamp();
+		if (!history_open_writer())
+			return;
+	}
+
+	if (HistorySampleContext == NULL)
+		HistorySampleContext = AllocSetContextCreate(TopMemoryContext,
+													 "system_stats history sample",
+													 ALLOCSET_SMALL_SIZES);
+
+	oldcontext = MemoryContextSwitchTo(HistorySampleContext);
+	collect_history_record(&record);
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(HistorySampleContext);
+
+	last_history_time = record.sample_time;
+
+	record.seq = writer_header->next_seq;
+	record.crc = history_record_crc(&record);
+	memcpy(HISTORY_RECORD(writer_base, writer_header->capacity, record.seq), &record, sizeof(history_record));
+
+	/* Readers must not see the new position before the record */
+	pg_write_barrier();
+	writer_header->next_seq = record.seq + 1;
+}
+
+/*
+ * Copy the record at given position of the history. Returns false if the
+ * record is not there anymore, or is torn.
+ */
+static bool read_history_record(char *base, uint32 capacity, uint64 seq, history_record *record)
+{
+	memcpy(record, HISTORY_RECORD(base, capacity, seq), sizeof(history_record));
+
+	return record->seq == seq && EQ_CRC32C(record->crc, history_record_crc(record));
+}
+
+/*
+ * Map the history file read only, keeping the mapping across calls as long
+ * as the file is the same. Returns false if there is no usable history.
+ */
+static bool history_map_file(history_map *map)
+{
+	int                 fd;
+	struct stat         st;
+	history_file_header *header;
+	char                *base;
+
+	if (stat(HISTORY_FILE_NAME, &st) < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+					errmsg("could not stat history file \"%s\": %m", HISTORY_FILE_NAME)));
+		return false;
+	}
+
+	if (map->base != NULL && map->dev == st.st_dev && map->ino == st.st_ino && map->size == st.st_size)
+		return true;
+
+	if (map->base != NULL)
+	{
+		munmap(map->base, map->size);
+		map->base = NULL;
+	}
+
+	if (st.st_size < HISTORY_HEADER_SIZE)
+		return false;
+
+	fd = OpenTransientFile(HISTORY_FILE_NAME, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+					errmsg("could not open history file \"%s\": %m", HISTORY_FILE_NAME)));
+		return false;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	CloseTransientFile(fd);
+
+	if (base == MAP_FAILED)
+	{
+		ereport(DEBUG1,
+				(errmsg("could not map history file \"%s\": %m", HISTORY_FILE_NAME)));
+		return false;
+	}
+
+	header = (history_file_header *) base;
+	if (header->magic != HISTORY_FILE_MAGIC || header->version != HISTORY_FILE_VERSION ||
+		header->record_size != sizeof(history_record) || header->capacity == 0 ||
+		HISTORY_HEADER_SIZE + (Size) header->capacity * sizeof(history_record) != st.st_size)
+	{
+		ereport(DEBUG1,
+				(errmsg("history file \"%s\" is not valid", HISTORY_FILE_NAME)));
+		munmap(base, st.st_size);
+		return false;
+	}
+
+	map->base = base;
+	map->size = st.st_size;
+	map->dev = st.st_dev;
+	map->ino = st.st_ino;
+
+	return true;
+}
+
+/* Compute the rate per second of a counter, NULL if it went backwards */
+static Datum counter_rate(uint64 previous, uint64 current, float8 seconds, bool *isnull)
+{
+	*isnull = (current < previous);
+	return Float8GetDatum(*isnull ? 0 : (current - previous) / seconds);
+}
+
+/*
+ * Add one row of the history. The CPU usage and the rates are computed
+ * against the previous record, and are NULL without one.
+ */
+static void put_history_row(Tuplestorestate *tupstore, TupleDesc tupdesc,
+							history_record *record, history_record *previous)
+{
+	Datum      values[Natts_history];
+	bool       nulls[Natts_history];
+	uint32     flags = record->flags;
+	float8     seconds = 0;
+	uint64     used_memory;
+	uint64     swap_used_memory;
+	int        index;
+
+	memset(nulls, 0, sizeof(nulls));
+
+	if (previous != NULL && previous->sample_time < record->sample_time)
+	{
+		flags &= previous->flags;
+		seconds = (record->sample_time - previous->sample_time) / (float8) USECS_PER_SEC;
+	}
+	else
+		previous = NULL;
+
+	values[Anum_history_sample_time] = TimestampTzGetDatum(record->sample_time);
+
+	if (previous != NULL && (flags & HISTORY_HAS_CPU))
+	{
+		struct cpu_stat *cur = &record->cpu;
+		struct cpu_stat *prev = &previous->cpu;
+		float8          total;
+
+		total = (cur->usermode_normal_process - prev->usermode_normal_process) +
+			(cur->usermode_niced_process - prev->usermode_niced_process) +
+			(cur->kernelmode_process - prev->kernelmode_process) +
+			(cur->idle_mode - prev->idle_mode) +
+			(cur->io_completion - prev->io_completion) +
+			(cur->servicing_irq - prev->servicing_irq) +
+			(cur->servicing_softirq - prev->servicing_softirq) +
+			(cur->steal_time - prev->steal_time);
+
+		if (total > 0)
+		{
+			values[Anum_history_usermode_normal_process] =
+				Float4GetDatum(fl_round(100.0 * (cur->usermode_normal_process - prev->usermode_normal_process) / total));
+			values[Anum_history_usermode_niced_process] =
+				Float4GetDatum(fl_round(100.0 * (cur->usermode_niced_process - prev->usermode_niced_process) / total));
+			values[Anum_history_kernelmode_process] =
+				Float4GetDatum(fl_round(100.0 * (cur->kernelmode_process - prev->kernelmode_process) / total));
+			values[Anum_history_idle_mode] =
+				Float4GetDatum(fl_round(100.0 * (cur->idle_mode - prev->idle_mode) / total));
+			values[Anum_history_io_completion] =
+				Float4GetDatum(fl_round(100.0 * (cur->io_completion - prev->io_completion) / total));
+			values[Anum_history_servicing_irq] =
+				Float4GetDatum(fl_round(100.0 * (cur->servicing_irq - prev->servicing_irq) / total));
+			values[Anum_history_servicing_softirq] =
+				Float4GetDatum(fl_round(100.0 * (cur->servicing_softirq - prev->servicing_softirq) / total));
+			values[Anum_history_steal_time] =
+				Float4GetDatum(fl_round(100.0 * (cur->steal_time - prev->steal_time) / total));
+		}
+		else
+		{
+			for (index = Anum_history_usermode_normal_process; index <= Anum_history_steal_time; index++)
+				nulls[index] = true;
+		}
+	}
+	else
+	{
+		for (index = Anum_history_usermode_normal_process; index <= Anum_history_steal_time; index++)
+			nulls[index] = true;
+	}
+
+	if (record->flags & HISTORY_HAS_MEMORY)
+	{
+		used_memory = record->total_memory - record->free_memory;
+		swap_used_memory = record->swap_total_memory - record->swap_free_memory;
+
+		values[Anum_history_total_memory] = Int64GetDatumFast(record->total_memory);
+		values[Anum_history_used_memory] = Int64GetDatumFast(used_memory);
+		values[Anum_history_free_memory] = Int64GetDatumFast(record->free_memory);
+		values[Anum_history_available_memory] = Int64GetDatumFast(record->available_memory);
+		values[Anum_history_cache_memory] = Int64GetDatumFast(record->cached_memory);
+		values[Anum_history_swap_total_memory] = Int64GetDatumFast(record->swap_total_memory);
+		values[Anum_history_swap_used_memory] = Int64GetDatumFast(swap_used_memory);
+		values[Anum_history_swap_free_memory] = Int64GetDatumFast(record->swap_free_memory);
+	}
+	else
+	{
+		for (index = Anum_history_total_memory; index <= Anum_history_swap_free_memory; index++)
+			nulls[index] = true;
+	}
+
+	if (record->flags & HISTORY_HAS_LOAD)
+	{
+		values[Anum_history_load_avg_one_minute] = Float4GetDatum(record->load_avg_one_minute);
+		values[Anum_history_load_avg_five_minutes] = Float4GetDatum(record->load_avg_five_minutes);
+		values[Anum_history_load_avg_fifteen_minutes] = Float4GetDatum(record->load_avg_fifteen_minutes);
+	}
+	else
+	{
+		for (index = Anum_history_load_avg_one_minute; index <= Anum_history_load_avg_fifteen_minutes; index++)
+			nulls[index] = true;
+	}
+
+	if (previous != NULL && (flags & HISTORY_HAS_DISK))
+	{
+		values[Anum_history_disk_reads] =
+			counter_rate(previous->disk_reads, record->disk_reads, seconds, &nulls[Anum_history_disk_reads]);
+		values[Anum_history_disk_writes] =
+			counter_rate(previous->disk_writes, record->disk_writes, seconds, &nulls[Anum_history_disk_writes]);
+		values[Anum_history_disk_read_bytes] =
+			counter_rate(previous->disk_read_bytes, record->disk_read_bytes, seconds, &nulls[Anum_history_disk_read_bytes]);
+		values[Anum_history_disk_write_bytes] =
+			counter_rate(previous->disk_write_bytes, record->disk_write_bytes, seconds, &nulls[Anum_history_disk_write_bytes]);
+	}
+	else
+	{
+		for (index = Anum_history_disk_reads; index <= Anum_history_disk_write_bytes; index++)
+			nulls[index] = true;
+	}
+
+	if (previous != NULL && (flags & HISTORY_HAS_NETWORK))
+	{
+		values[Anum_history_net_rx_bytes] =
+			counter_rate(previous->net_rx_bytes, record->net_rx_bytes, seconds, &nulls[Anum_history_net_rx_bytes]);
+		values[Anum_history_net_tx_bytes] =
+			counter_rate(previous->net_tx_bytes, record->net_tx_bytes, seconds, &nulls[Anum_history_net_tx_bytes]);
+		values[Anum_history_net_rx_packets] =
+			counter_rate(previous->net_rx_packets, record->net_rx_packets, seconds, &nulls[Anum_history_net_rx_packets]);
+		values[Anum_history_net_tx_packets] =
+			counter_rate(previous->net_tx_packets, record->net_tx_packets, seconds, &nulls[Anum_history_net_tx_packets]);
+	}
+	else
+	{
+		for (index = Anum_history_net_rx_bytes; index <= Anum_history_net_tx_packets; index++)
+			nulls[index] = true;
+	}
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
+
+/*
+ * Return the records of the history taken between start_time and end_time.
+ * The first record is found with a binary search on the mapped file, and
+ * only the records returned are copied, so a short range costs the same
+ * whatever the size of the history.
+ */
+void ReadHistory(Tuplestorestate *tupstore, TupleDesc tupdesc, TimestampTz start_time, TimestampTz end_time)
+{
+	history_file_header *header;
+	history_record      record;
+	history_record      previous;
+	bool                has_previous;
+	uint32              capacity;
+	uint64              newest;
+	uint64              oldest;
+	uint64              low;
+	uint64              high;
+	uint64              seq;
+
+	if (!history_map_file(&reader_map))
+		return;
+
+	header = (history_file_header *) reader_map.base;
+	capacity = header->capacity;
+	newest = header->next_seq - 1;
+	pg_read_barrier();
+
+	if (newest == 0)
+		return;
+
+	oldest = (newest > capacity) ? newest - capacity + 1 : 1;
+
+	/* Find the first record taken at or after start_time */
+	low = oldest;
+	high = newest + 1;
+	while (low < high)
+	{
+		uint64 middle = low + (high - low) / 2;
+
+		if (!read_history_record(reader_map.base, capacity, middle, &record) ||
+			record.sample_time < start_time)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	has_previous = (low > oldest && read_history_record(reader_map.base, capacity, low - 1, &previous));
+
+	for (seq = low; seq <= newest; seq++)
+	{
+		if (!read_history_record(reader_map.base, capacity, seq, &record))
+		{
+			has_previous = false;
+			continue;
+		}
+
+		if (record.sample_time > end_time)
+			break;
+
+		put_history_row(tupstore, tupdesc, &record, has_previous ? &previous : NULL);
+
+		previous = record;
+		has_previous = true;
+	}
+}
+
+/* Return the state of the history file */
+void ReadHistoryInfo(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum               values[Natts_history_info];
+	bool                nulls[Natts_history_info];
+	history_file_header *header;
+	history_record      record;
+	uint32              capacity;
+	uint64              newest;
+	uint64              oldest;
+	uint64              num_records;
+
+	memset(nulls, 0, sizeof(nulls));
+
+	if (!history_map_file(&reader_map))
+		return;
+
+	header = (history_file_header *) reader_map.base;
+	capacity = header->capacity;
+	newest = header->next_seq - 1;
+	pg_read_barrier();
+
+	oldest = (newest > capacity) ? newest - capacity + 1 : 1;
+	num_records = (newest >= oldest) ? newest - oldest + 1 : 0;
+
+	values[Anum_history_file_name] = CStringGetTextDatum(HISTORY_FILE_NAME);
+	values[Anum_history_record_size] = Int32GetDatum(header->record_size);
+	values[Anum_history_capacity] = Int64GetDatum((int64) capacity);
+	values[Anum_history_num_records] = Int64GetDatum((int64) num_records);
+
+	/* The oldest slot may be overwritten right now, use the next one then */
+	if (num_records > 0 && (read_history_record(reader_map.base, capacity, oldest, &record) ||
+							(oldest < newest && read_history_record(reader_map.base, capacity, oldest + 1, &record))))
+		values[Anum_history_oldest_sample] = TimestampTzGetDatum(record.sample_time);
+	else
+		nulls[Anum_history_oldest_sample] = true;
+
+	if (num_records > 0 && read_history_record(reader_map.base, capacity, newest, &record))
+		values[Anum_history_newest_sample] = TimestampTzGetDatum(record.sample_time);
+	else
+		nulls[Anum_history_newest_sample] = true;
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
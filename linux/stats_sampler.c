@@ -0,0 +1,274 @@
+/*------------------------------------------------------------------------
+ * stats_sampler.c
+ *              Background worker taking periodic samples of system
+ *              statistics into a shared memory ring buffer
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/guc.h"
+#include "utils/timestamp.h"
+
+/* structure used to store one sample taken by the background sampler */
+typedef struct SystemSample
+{
+	TimestampTz     sample_time;
+	struct cpu_stat cpu;
+	pressure_sample pressure;
+} SystemSample;
+
+/* structure stored in shared memory, protected by lock */
+typedef struct SamplerSharedState
+{
+	LWLock          *lock;
+	uint64          sample_count;   /* total number of samples ever taken */
+	SystemSample    samples[SAMPLER_RING_SIZE];
+} SamplerSharedState;
+
+/* interval between two samples, in milliseconds */
+static int sampler_interval_ms = SAMPLER_DEFAULT_INTERVAL_MS;
+
+static SamplerSharedState *sampler_state = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void sampler_shmem_request(void);
+static void sampler_shmem_startup(void);
+static TimestampTz TakeSystemSample(void);
+
+/*
+ * Define the GUCs of the sampler and, when loaded through
+ * shared_preload_libraries, reserve shared memory and register the
+ * background worker.
+ */
+void InitSystemStatsSampler(void)
+{
+	BackgroundWorker worker;
+
+	DefineCustomIntVariable("system_stats.sampler_interval",
+							"Sets the interval between two samples taken by the background sampler.",
+							NULL,
+							&sampler_interval_ms,
+							SAMPLER_DEFAULT_INTERVAL_MS,
+							100,
+							3600000,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	/* The sampler can only run when loaded at server start */
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	/* The history size is a PGC_POSTMASTER GUC, only definable at preload */
+	InitSystemStatsHistory();
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = sampler_shmem_request;
+#else
+	sampler_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = sampler_shmem_startup;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = 10;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "system_stats");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "SystemStatsSamplerMain");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "system_stats sampler");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "system_stats sampler");
+
+	RegisterBackgroundWorker(&worker);
+}
+
+/* Reserve the shared memory and the lock used by the sampler */
+static void sampler_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(SamplerSharedState)));
+	RequestNamedLWLockTranche(SAMPLER_TRANCHE_NAME, 1);
+}
+
+/* Allocate or attach to the shared memory used by the sampler */
+static void sampler_shmem_startup(void)
+{
+	bool found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	sampler_state = ShmemInitStruct(SAMPLER_SHMEM_NAME, sizeof(SamplerSharedState), &found);
+
+	if (!found)
+	{
+		memset(sampler_state, 0, sizeof(SamplerSharedState));
+		sampler_state->lock = &(GetNamedLWLockTranche(SAMPLER_TRANCHE_NAME))->lock;
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Take one sample and store it in the next slot of the ring buffer.
+ * Returns the time of the sample.
+ */
+static TimestampTz TakeSystemSample(void)
+{
+	SystemSample sample;
+
+	memset(&sample, 0, sizeof(sample));
+
+	/* Read the files outside the lock so readers are never blocked on I/O */
+	sample.sample_time = GetCurrentTimestamp();
+	cpu_stat_information(&sample.cpu);
+	ReadPressureSample(&sample.pressure);
+
+	LWLockAcquire(sampler_state->lock, LW_EXCLUSIVE);
+	sampler_state->samples[sampler_state->sample_count % SAMPLER_RING_SIZE] = sample;
+	sampler_state->sample_count++;
+	LWLockRelease(sampler_state->lock);
+
+	return sample.sample_time;
+}
+
+/* Entry point of the background sampler */
+void SystemStatsSamplerMain(Datum main_arg)
+{
+	TimestampTz last_sample_time;
+	long        elapsed_ms;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	BackgroundWorkerUnblockSignals();
+
+	ereport(LOG, (errmsg("system_stats sampler started")));
+
+	while (!ShutdownRequestPending)
+	{
+		last_sample_time = TakeSystemSample();
+		TakeHistorySample();
+
+		/*
+		 * Wait for the rest of the interval since the sample, also after an
+		 * early wakeup such as the SIGHUP of a configuration reload, so the
+		 * two most recent samples are never only milliseconds apart.
+		 */
+		while (!ShutdownRequestPending)
+		{
+			elapsed_ms = TimestampDifferenceMilliseconds(last_sample_time, GetCurrentTimestamp());
+			if (elapsed_ms >= sampler_interval_ms)
+				break;
+
+			(void) WaitLatch(MyLatch,
+							 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+							 sampler_interval_ms - elapsed_ms,
+							 PG_WAIT_EXTENSION);
+			ResetLatch(MyLatch);
+
+			if (ConfigReloadPending)
+			{
+				ConfigReloadPending = false;
+				ProcessConfigFile(PGC_SIGHUP);
+			}
+		}
+	}
+
+	proc_exit(0);
+}
+
+/*
+ * Copy the two most recent CPU samples taken by the background sampler.
+ * Returns false if the sampler is not running or has not produced two
+ * recent samples yet, in which case the caller has to sample itself.
+ */
+bool ReadLatestCPUSamples(struct cpu_stat *first_sample, struct cpu_stat *second_sample)
+{
+	SystemSample *previous;
+	SystemSample *latest;
+	bool         found = false;
+
+	if (sampler_state == NULL)
+		return false;
+
+	LWLockAcquire(sampler_state->lock, LW_SHARED);
+
+	if (sampler_state->sample_count >= 2)
+	{
+		previous = &sampler_state->samples[(sampler_state->sample_count - 2) % SAMPLER_RING_SIZE];
+		latest = &sampler_state->samples[(sampler_state->sample_count - 1) % SAMPLER_RING_SIZE];
+
+		/* Ignore samples left behind by a sampler that has stopped */
+		if (!TimestampDifferenceExceeds(latest->sample_time, GetCurrentTimestamp(),
+										2 * sampler_interval_ms))
+		{
+			*first_sample = previous->cpu;
+			*second_sample = latest->cpu;
+			found = true;
+		}
+	}
+
+	LWLockRelease(sampler_state->lock);
+
+	return found;
+}
+
+/*
+ * Copy the pressure stall information of the two most recent samples taken
+ * by the background sampler, with the same rules as ReadLatestCPUSamples.
+ */
+bool ReadLatestPressureSamples(pressure_sample *first_sample, pressure_sample *second_sample)
+{
+	SystemSample *previous;
+	SystemSample *latest;
+	bool         found = false;
+
+	if (sampler_state == NULL)
+		return false;
+
+	LWLockAcquire(sampler_state->lock, LW_SHARED);
+
+	if (sampler_state->sample_count >= 2)
+	{
+		previous = &sampler_state->samples[(sampler_state->sample_count - 2) % SAMPLER_RING_SIZE];
+		latest = &sampler_state->samples[(sampler_state->sample_count - 1) % SAMPLER_RING_SIZE];
+
+		if (!TimestampDifferenceExceeds(latest->sample_time, GetCurrentTimestamp(),
+										2 * sampler_interval_ms))
+		{
+			*first_sample = previous->pressure;
+			*second_sample = latest->pressure;
+			found = true;
+		}
+	}
+
+	LWLockRelease(sampler_state->lock);
+
+	return found;
+}
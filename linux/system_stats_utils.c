@@ -10,67 +10,18 @@
 #include "postgres.h"
 #include "system_stats.h"
 
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/latch.h"
+#include "utils/timestamp.h"
+
 #include <ctype.h>
 #include <string.h>
 #include <stdio.h>
 
-#include <sys/types.h>
-#include <dirent.h>
-
 char* leftTrimStr(char* s);
 char* rightTrimStr(char* s);
 
-/* Function used to convert KB, MB, GB to bytes */
-uint64_t ConvertToBytes(char *line_buf)
-{
-	uint64_t value = 0;
-	char *found = strstr(line_buf, ":");
-	if (found)
-	{
-		char result[MAXPGPATH];
-		char suffix[MAXPGPATH];
-		char *token = NULL;
-		int icount = 0;
-		memset(result, 0x00, MAXPGPATH);
-		memset(suffix, 0x00, MAXPGPATH);
-		found = trimStr((found+1));
-
-		token = strtok(found, " ");
-		while( token != NULL )
-		{
-			if (icount == 0)
-				memcpy(result, token, strlen(token));
-			else
-			{
-				memcpy(suffix, token, strlen(token));
-				break;
-			}
-
-			token = strtok(NULL, " ");icount++;
-			icount++;
-		}
-
-		if (strcasecmp(suffix, "kb") == 0)
-		{
-			value = (uint64_t)atoll(result);
-			value = value * 1024;
-		}
-		else if (strcasecmp(suffix, "mb") == 0)
-		{
-			value = (uint64_t)atoll(result);
-			value = value * 1024 * 1024;
-		}
-		else if (strcasecmp(suffix, "gb") == 0)
-		{
-			value = (uint64_t)atoll(result);
-			value = value * 1024 * 1024 * 1024;
-		}
-		else
-			value = (uint64_t)atoll(result);
-	}
-	return value;
-}
-
 /* Function used to check the string is a number or not */
 bool stringIsNumber(char *str)
 {
@@ -136,90 +87,59 @@ float fl_round(float val)
 bool read_process_status(int *active_processes, int *running_processes,
 		int *sleeping_processes, int *stopped_processes, int *zombie_processes, int *total_threads)
 {
-	FILE          *fpstat;
-	DIR           *dirp;
-	struct dirent *ent, dbuf;
-	char          file_name[MIN_BUFFER_SIZE];
-	char          process_type;
-	unsigned int  running_threads;
-	int           active_pro = 0;
-	int           running_pro = 0;
-	int           sleeping_pro = 0;
-	int           stopped_pro = 0;
-	int           zombie_pro = 0;
-
-	dirp = opendir(PROC_FILE_SYSTEM_PATH);
-	if (!dirp)
-	{
-		ereport(DEBUG1, (errmsg("Error opening /proc directory")));
+	process_snapshot *snapshot;
+	process_stat     *entry;
+	int              index;
+	int              running_pro = 0;
+	int              sleeping_pro = 0;
+	int              stopped_pro = 0;
+	int              zombie_pro = 0;
+	int              threads = 0;
+
+	/* Share the walk of /proc with the other functions of this statement */
+	snapshot = GetStatementProcessSnapshot();
+	if (snapshot == NULL)
 		return false;
-	}
 
-	/* Read the proc directory for process status */
-	while (readdir_r(dirp, &dbuf, &ent) == 0)
+	for (index = 0; index < snapshot->num_entries; index++)
 	{
-		memset(file_name, 0x00, MIN_BUFFER_SIZE);
-		process_type = '\0';
+		entry = &snapshot->entries[index];
 
-		if (!ent)
-			break;
-
-		/* Iterate only digit as name because it is process id */
-		if (!isdigit(*ent->d_name))
-			continue;
-
-		active_pro++;
-
-		sprintf(file_name,"/proc/%s/stat", ent->d_name);
-
-		fpstat = fopen(file_name, "r");
-		if (fpstat == NULL)
-			continue;
-
-		if (fscanf(fpstat, "%*d %*s %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u"
-					"%*d %*d %*d %*d %d %*d %*u %*u %*d", &process_type, &running_threads) == EOF)
-			ereport(DEBUG1, (errmsg("Error in parsing file '%s'", file_name)));
-
-		if (process_type == 'R')
+		if (entry->state == 'R')
 			running_pro++;
-		else if(process_type == 'S' || process_type == 'D')
+		else if(entry->state == 'S' || entry->state == 'D')
 			sleeping_pro++;
-		else if (process_type == 'T')
+		else if (entry->state == 'T')
 			stopped_pro++;
-		else if (process_type == 'Z')
+		else if (entry->state == 'Z')
 			zombie_pro++;
 		else
-			ereport(DEBUG1, (errmsg("Invalid process type '%c'", process_type)));
+			ereport(DEBUG1, (errmsg("Invalid process type '%c'", entry->state)));
 
-		*total_threads = *total_threads + running_threads;
-
-		fclose(fpstat);
-		fpstat = NULL;
+		threads += entry->num_threads;
 	}
 
-	*active_processes = active_pro;
+	*active_processes = snapshot->num_entries;
 	*running_processes = running_pro;
 	*sleeping_processes = sleeping_pro;
 	*stopped_processes = stopped_pro;
 	*zombie_processes = zombie_pro;
-
-	closedir(dirp);
-	dirp = NULL;
+	*total_threads = threads;
 
 	return true;
 }
 
 void ReadFileContent(const char *file_name, uint64 *data)
 {
-	FILE       *fp = NULL;
-	char       *line_buf = NULL;
-	size_t     line_buf_size = 0;
-	ssize_t    line_size = 0;
+	char       *content;
 
-	/* Read the file of given file name */
-	fp = fopen(file_name, "r");
+	/*
+	 * The files are per device attributes of /sys read once per device, so
+	 * they are not kept open by the file cache
+	 */
+	content = ReadProcFile(file_name, NULL);
 
-	if (!fp)
+	if (content == NULL)
 	{
 		char net_file_name[MAXPGPATH];
 		snprintf(net_file_name, MAXPGPATH, "%s", file_name);
@@ -231,19 +151,137 @@ void ReadFileContent(const char *file_name, uint64 *data)
 		return;
 	}
 
-	/* Get the first line of the file. */
-	line_size = getline(&line_buf, &line_buf_size, fp);
-
 	/* Read the content of the file and convert to int64 from string */
-	if (line_size > 0)
-		*data = atoll(line_buf);
+	if (content[0] != '\0')
+		*data = atoll(content);
+
+	pfree(content);
+}
+
+/*
+ * Tell whether the previous sample kept by this backend for a collector,
+ * taken at given time, is too old to compute rates against. A monitoring
+ * session polling regularly gets the rates since its last poll without any
+ * wait; an older sample would only give an average over a long period.
+ */
+bool PreviousSampleExpired(TimestampTz sample_time)
+{
+	return TimestampDifferenceExceeds(sample_time, GetCurrentTimestamp(),
+									  PREVIOUS_SAMPLE_MAX_AGE_MS);
+}
+
+/*
+ * Wait for the part of the sampling interval that has not already elapsed
+ * since the first of two samples was taken. The wait is on the latch of the
+ * backend, so a query cancel or a termination request is served at once
+ * instead of at the end of the interval.
+ */
+void WaitSampleInterval(TimestampTz first_sample_time, int interval_ms)
+{
+	long elapsed_ms;
 
-	/* Free the allocated line buffer */
-	if (line_buf != NULL)
+	for (;;)
 	{
-		free(line_buf);
-		line_buf = NULL;
+		CHECK_FOR_INTERRUPTS();
+
+		elapsed_ms = TimestampDifferenceMilliseconds(first_sample_time, GetCurrentTimestamp());
+		if (elapsed_ms >= interval_ms)
+			break;
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 interval_ms - elapsed_ms,
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
 	}
+}
+
+/*
+ * Find the directory of the cgroup v2 hierarchy the server runs in, from
+ * the mount point of the cgroup2 file system in /proc/self/mountinfo and
+ * the "0::" line of /proc/self/cgroup. The mount point is looked up once
+ * per backend; the cgroup is read on every call since a process can be
+ * moved. Returns false if there is no cgroup v2 hierarchy.
+ */
+bool GetCgroupDirectory(char *path, int len)
+{
+	static char mount_point[MAXPGPATH];
+	static char mount_root[MAXPGPATH];
+	static bool mount_point_read = false;
+	char        *content;
+	char        *line;
+	char        *next_line;
+	char        *cgroup = NULL;
+	size_t      root_len;
+
+	if (!mount_point_read)
+	{
+		mount_point_read = true;
+		mount_point[0] = '\0';
+
+		content = ReadProcFile(CGROUP_MOUNT_INFO_FILE_NAME, NULL);
+		if (content == NULL)
+			return false;
 
-	fclose(fp);
+		/* The fields are: id parent major:minor root mount_point options ... - type source ... */
+		for (line = content; line != NULL; line = next_line)
+		{
+			char root[MAXPGPATH];
+			char mnt[MAXPGPATH];
+			char *separator;
+
+			next_line = strchr(line, '\n');
+			if (next_line != NULL)
+				*next_line++ = '\0';
+
+			separator = strstr(line, " - ");
+			if (separator == NULL || strncmp(separator + 3, "cgroup2 ", 8) != 0)
+				continue;
+
+			if (sscanf(line, "%*d %*d %*s %1023s %1023s", root, mnt) != 2)
+				continue;
+
+			strlcpy(mount_root, root, MAXPGPATH);
+			strlcpy(mount_point, mnt, MAXPGPATH);
+			break;
+		}
+
+		pfree(content);
+	}
+
+	if (mount_point[0] == '\0')
+		return false;
+
+	content = ReadCachedProcFile(CGROUP_SELF_FILE_NAME, NULL);
+	if (content == NULL)
+		return false;
+
+	for (line = content; line != NULL; line = next_line)
+	{
+		next_line = strchr(line, '\n');
+		if (next_line != NULL)
+			*next_line++ = '\0';
+
+		if (strncmp(line, "0::", 3) == 0)
+		{
+			cgroup = line + 3;
+			break;
+		}
+	}
+
+	if (cgroup == NULL)
+		return false;
+
+	/* The path is relative to the root of the hierarchy, which may not be the mounted one */
+	root_len = strlen(mount_root);
+	if (root_len > 1 && strncmp(cgroup, mount_root, root_len) == 0 &&
+		(cgroup[root_len] == '/' || cgroup[root_len] == '\0'))
+		cgroup += root_len;
+
+	if (strcmp(cgroup, "/") == 0)
+		cgroup = "";
+
+	snprintf(path, len, "%s%s", mount_point, cgroup);
+
+	return true;
 }
@@ -0,0 +1,231 @@
+/*------------------------------------------------------------------------
+ * vmstat_info.c
+ *              Virtual memory event counters of the kernel
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+#include "utils/timestamp.h"
+
+/* interval between two samples when there is no recent previous sample */
+#define VMSTAT_SAMPLE_INTERVAL_MS     500
+
+/* counter of /proc/vmstat reported by ReadVmstatInformation */
+typedef struct vmstat_counter
+{
+	const char *name;
+	/* a number of pages at the time of the sample rather than events */
+	bool        gauge;
+	/* summed over the lines of the kernels which split it, see vmstat_suffixes */
+	bool        split;
+} vmstat_counter;
+
+/*
+ * Page faults, swapping, reclaim, compaction, dirty pages and writeback.
+ * allocstall and the reclaim counters of kernels before 4.8 have one line
+ * per memory zone, such as allocstall_normal, and workingset_refault one
+ * line per LRU list since Linux 5.9; these lines are summed.
+ */
+static const vmstat_counter vmstat_counters[] = {
+	{"pgfault", false, false},
+	{"pgmajfault", false, false},
+	{"pgpgin", false, false},
+	{"pgpgout", false, false},
+	{"pswpin", false, false},
+	{"pswpout", false, false},
+	{"pgscan_kswapd", false, true},
+	{"pgscan_direct", false, true},
+	{"pgscan_direct_throttle", false, false},
+	{"pgsteal_kswapd", false, true},
+	{"pgsteal_direct", false, true},
+	{"allocstall", false, true},
+	{"compact_stall", false, false},
+	{"workingset_refault", false, true},
+	{"oom_kill", false, false},
+	{"nr_dirtied", false, false},
+	{"nr_written", false, false},
+	{"nr_dirty", true, false},
+	{"nr_writeback", true, false}
+};
+
+#define NUM_VMSTAT_COUNTERS    lengthof(vmstat_counters)
+
+/* suffixes of the lines of the split counters, memory zones and LRU lists */
+static const char *const vmstat_suffixes[] = {
+	"dma",
+	"dma32",
+	"normal",
+	"high",
+	"movable",
+	"anon",
+	"file"
+};
+
+typedef struct vmstat_sample
+{
+	TimestampTz sample_time;
+	uint64      values[NUM_VMSTAT_COUNTERS];
+	bool        present[NUM_VMSTAT_COUNTERS];
+} vmstat_sample;
+
+/* previous sample of this backend, see ReadVmstatInformation */
+static vmstat_sample previous_vmstat_sample;
+static bool          previous_vmstat_sample_valid = false;
+
+void ReadVmstatInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+static int vmstat_lookup(const char *key, int key_len);
+static bool take_vmstat_sample(vmstat_sample *sample);
+
+/*
+ * Find the counter of given key of /proc/vmstat, either its name or, for
+ * the split counters, its name followed by "_<suffix>". Returns -1 if the
+ * key is not reported.
+ */
+static int vmstat_lookup(const char *key, int key_len)
+{
+	int counter;
+	int suffix;
+	int name_len;
+
+	for (counter = 0; counter < NUM_VMSTAT_COUNTERS; counter++)
+	{
+		name_len = strlen(vmstat_counters[counter].name);
+
+		if (key_len < name_len || strncmp(key, vmstat_counters[counter].name, name_len) != 0)
+			continue;
+
+		if (key_len == name_len)
+			return counter;
+
+		if (!vmstat_counters[counter].split || key[name_len] != '_')
+			continue;
+
+		for (suffix = 0; suffix < lengthof(vmstat_suffixes); suffix++)
+		{
+			if (key_len - name_len - 1 == strlen(vmstat_suffixes[suffix]) &&
+				strncmp(key + name_len + 1, vmstat_suffixes[suffix], key_len - name_len - 1) == 0)
+				return counter;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Read the counters of /proc/vmstat, made of "<name> <value>" lines, in a
+ * single pass over the content of the file. The file returns about a page
+ * per read, so it is read to the end of file with ReadProcFile.
+ */
+static bool take_vmstat_sample(vmstat_sample *sample)
+{
+	char *content;
+	char *pos;
+	char *key;
+	int  counter;
+
+	memset(sample, 0, sizeof(vmstat_sample));
+
+	content = ReadProcFile(VMSTAT_FILE_NAME, NULL);
+	if (content == NULL)
+	{
+		ereport(DEBUG1,
+				(errmsg("can not read file %s for reading vmstat information",
+					VMSTAT_FILE_NAME)));
+		return false;
+	}
+
+	sample->sample_time = GetCurrentTimestamp();
+
+	for (pos = content; *pos != '\0'; pos++)
+	{
+		key = pos;
+		while (*pos != ' ' && *pos != '\n' && *pos != '\0')
+			pos++;
+
+		if (*pos == ' ')
+		{
+			counter = vmstat_lookup(key, pos - key);
+			if (counter >= 0)
+			{
+				/* A split counter adds up over its lines */
+				sample->values[counter] += strtoull(pos + 1, &pos, 10);
+				sample->present[counter] = true;
+			}
+		}
+
+		/* Skip to the end of the line */
+		while (*pos != '\n' && *pos != '\0')
+			pos++;
+		if (*pos == '\0')
+			break;
+	}
+
+	pfree(content);
+
+	return true;
+}
+
+/*
+ * Report the selected counters of /proc/vmstat, one row per counter the
+ * kernel reports, with their rate per second. The rates are computed
+ * against the previous call of this backend when it is recent enough,
+ * otherwise two samples are taken VMSTAT_SAMPLE_INTERVAL_MS apart. The
+ * gauges, such as nr_dirty, have no rate.
+ */
+void ReadVmstatInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	Datum         values[Natts_vmstat_info];
+	bool          nulls[Natts_vmstat_info];
+	vmstat_sample current;
+	float8        interval_ms;
+	float8        seconds;
+	int           counter;
+
+	if (!previous_vmstat_sample_valid ||
+		PreviousSampleExpired(previous_vmstat_sample.sample_time))
+	{
+		previous_vmstat_sample_valid = take_vmstat_sample(&previous_vmstat_sample);
+		if (!previous_vmstat_sample_valid)
+			return;
+	}
+
+	/* Wait for the part of the sampling interval that has not elapsed yet */
+	WaitSampleInterval(previous_vmstat_sample.sample_time, VMSTAT_SAMPLE_INTERVAL_MS);
+
+	if (!take_vmstat_sample(&current))
+		return;
+
+	interval_ms = (current.sample_time - previous_vmstat_sample.sample_time) / 1000.0;
+	seconds = interval_ms / 1000.0;
+
+	for (counter = 0; counter < NUM_VMSTAT_COUNTERS; counter++)
+	{
+		if (!current.present[counter])
+			continue;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[Anum_vmstat_name] = CStringGetTextDatum(vmstat_counters[counter].name);
+		values[Anum_vmstat_value] = Int64GetDatum((int64) current.values[counter]);
+		values[Anum_vmstat_interval_ms] = Float8GetDatum(interval_ms);
+
+		/* The counters go backwards only if they wrapped around */
+		if (vmstat_counters[counter].gauge || !previous_vmstat_sample.present[counter] ||
+			current.values[counter] < previous_vmstat_sample.values[counter] || seconds <= 0)
+			nulls[Anum_vmstat_per_sec] = true;
+		else
+			values[Anum_vmstat_per_sec] =
+				Float8GetDatum((current.values[counter] - previous_vmstat_sample.values[counter]) / seconds);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* The current sample is the previous one of the next call */
+	previous_vmstat_sample = current;
+}
@@ -0,0 +1,497 @@
+/* system_stats--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION system_stats UPDATE TO '1.1'" to load this file. \quit
+
+-- CPU and memory information of the given process ids
+CREATE FUNCTION pg_sys_cpu_memory_by_process(
+    IN pids int[],
+    OUT pid int,
+    OUT name text,
+    OUT running_since_seconds int8,
+    OUT cpu_usage float4,
+    OUT memory_usage float4,
+    OUT memory_bytes int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_sys_cpu_memory_by_process_pids'
+LANGUAGE C STRICT;
+
+REVOKE ALL ON FUNCTION pg_sys_cpu_memory_by_process(int[]) FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_cpu_memory_by_process(int[]) TO monitor_system_stats;
+
+-- CPU and memory information of the processes whose name matches a LIKE pattern
+CREATE FUNCTION pg_sys_cpu_memory_by_process_name(
+    IN name_pattern text,
+    OUT pid int,
+    OUT name text,
+    OUT running_since_seconds int8,
+    OUT cpu_usage float4,
+    OUT memory_usage float4,
+    OUT memory_bytes int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_sys_cpu_memory_by_process_name'
+LANGUAGE C STRICT;
+
+REVOKE ALL ON FUNCTION pg_sys_cpu_memory_by_process_name(text) FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_cpu_memory_by_process_name(text) TO monitor_system_stats;
+
+-- CPU and memory information of the processes using the most CPU or memory
+CREATE FUNCTION pg_sys_top_processes(
+    IN n int,
+    IN order_by text DEFAULT 'cpu',
+    OUT pid int,
+    OUT name text,
+    OUT running_since_seconds int8,
+    OUT cpu_usage float4,
+    OUT memory_usage float4,
+    OUT memory_bytes int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+REVOKE ALL ON FUNCTION pg_sys_top_processes(int, text) FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_top_processes(int, text) TO monitor_system_stats;
+
+-- CPU, memory and page faults of the backends, joinable with pg_stat_activity
+CREATE FUNCTION pg_sys_backend_resource_usage(
+    OUT pid int,
+    OUT name text,
+    OUT state text,
+    OUT cpu_usage float4,
+    OUT memory_usage float4,
+    OUT memory_bytes int8,
+    OUT minor_faults int8,
+    OUT major_faults int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_backend_resource_usage() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_backend_resource_usage() TO monitor_system_stats;
+
+-- CPU usage information of each CPU
+CREATE FUNCTION pg_sys_cpu_usage_per_core(
+    OUT cpu int,
+    OUT usermode_normal_process_percent float4,
+    OUT usermode_niced_process_percent float4,
+    OUT kernelmode_process_percent float4,
+    OUT idle_mode_percent float4,
+    OUT IO_completion_percent float4,
+    OUT servicing_irq_percent float4,
+    OUT servicing_softirq_percent float4,
+    OUT steal_time_percent float4,
+    OUT guest_mode_percent float4,
+    OUT guest_niced_mode_percent float4
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_cpu_usage_per_core() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_cpu_usage_per_core() TO monitor_system_stats;
+
+-- All the memory information reported by the system
+CREATE FUNCTION pg_sys_memory_info_detailed(
+    OUT mem_total int8,
+    OUT mem_free int8,
+    OUT mem_available int8,
+    OUT buffers int8,
+    OUT cached int8,
+    OUT swap_cached int8,
+    OUT active int8,
+    OUT inactive int8,
+    OUT active_anon int8,
+    OUT inactive_anon int8,
+    OUT active_file int8,
+    OUT inactive_file int8,
+    OUT unevictable int8,
+    OUT mlocked int8,
+    OUT swap_total int8,
+    OUT swap_free int8,
+    OUT zswap int8,
+    OUT zswapped int8,
+    OUT dirty int8,
+    OUT writeback int8,
+    OUT anon_pages int8,
+    OUT mapped int8,
+    OUT shmem int8,
+    OUT kreclaimable int8,
+    OUT slab int8,
+    OUT sreclaimable int8,
+    OUT sunreclaim int8,
+    OUT kernel_stack int8,
+    OUT page_tables int8,
+    OUT sec_page_tables int8,
+    OUT nfs_unstable int8,
+    OUT bounce int8,
+    OUT writeback_tmp int8,
+    OUT commit_limit int8,
+    OUT committed_as int8,
+    OUT vmalloc_total int8,
+    OUT vmalloc_used int8,
+    OUT vmalloc_chunk int8,
+    OUT percpu int8,
+    OUT hardware_corrupted int8,
+    OUT anon_huge_pages int8,
+    OUT shmem_huge_pages int8,
+    OUT shmem_pmd_mapped int8,
+    OUT file_huge_pages int8,
+    OUT file_pmd_mapped int8,
+    OUT cma_total int8,
+    OUT cma_free int8,
+    OUT unaccepted int8,
+    OUT balloon int8,
+    OUT huge_pages_total int8,
+    OUT huge_pages_free int8,
+    OUT huge_pages_rsvd int8,
+    OUT huge_pages_surp int8,
+    OUT hugepagesize int8,
+    OUT hugetlb int8,
+    OUT direct_map_4k int8,
+    OUT direct_map_2m int8,
+    OUT direct_map_1g int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_memory_info_detailed() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_memory_info_detailed() TO monitor_system_stats;
+
+-- Samples of the history kept by the background sampler
+CREATE FUNCTION pg_sys_history(
+    start_time timestamptz DEFAULT now() - interval '1 hour',
+    end_time timestamptz DEFAULT now(),
+    OUT sample_time timestamptz,
+    OUT usermode_normal_process_percent float4,
+    OUT usermode_niced_process_percent float4,
+    OUT kernelmode_process_percent float4,
+    OUT idle_mode_percent float4,
+    OUT IO_completion_percent float4,
+    OUT servicing_irq_percent float4,
+    OUT servicing_softirq_percent float4,
+    OUT steal_time_percent float4,
+    OUT total_memory int8,
+    OUT used_memory int8,
+    OUT free_memory int8,
+    OUT available_memory int8,
+    OUT cache_total int8,
+    OUT swap_total int8,
+    OUT swap_used int8,
+    OUT swap_free int8,
+    OUT load_avg_one_minute float4,
+    OUT load_avg_five_minutes float4,
+    OUT load_avg_fifteen_minutes float4,
+    OUT disk_reads_per_sec float8,
+    OUT disk_writes_per_sec float8,
+    OUT disk_read_bytes_per_sec float8,
+    OUT disk_write_bytes_per_sec float8,
+    OUT net_rx_bytes_per_sec float8,
+    OUT net_tx_bytes_per_sec float8,
+    OUT net_rx_packets_per_sec float8,
+    OUT net_tx_packets_per_sec float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+REVOKE ALL ON FUNCTION pg_sys_history(timestamptz, timestamptz) FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_history(timestamptz, timestamptz) TO monitor_system_stats;
+
+-- State of the history file
+CREATE FUNCTION pg_sys_history_info(
+    OUT file_name text,
+    OUT record_size int4,
+    OUT capacity int8,
+    OUT num_records int8,
+    OUT oldest_sample timestamptz,
+    OUT newest_sample timestamptz
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_history_info() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_history_info() TO monitor_system_stats;
+
+-- I/O rates of each block device, as computed by iostat -x
+CREATE FUNCTION pg_sys_io_rates(
+    OUT device_name text,
+    OUT reads_per_sec float8,
+    OUT writes_per_sec float8,
+    OUT discards_per_sec float8,
+    OUT flushes_per_sec float8,
+    OUT read_mb_per_sec float8,
+    OUT write_mb_per_sec float8,
+    OUT discard_mb_per_sec float8,
+    OUT reads_merged_per_sec float8,
+    OUT writes_merged_per_sec float8,
+    OUT read_await_ms float8,
+    OUT write_await_ms float8,
+    OUT discard_await_ms float8,
+    OUT flush_await_ms float8,
+    OUT await_ms float8,
+    OUT avg_queue_size float8,
+    OUT util_percent float8,
+    OUT in_flight int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_io_rates() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_io_rates() TO monitor_system_stats;
+
+-- Pressure stall information of the system and cgroup
+CREATE FUNCTION pg_sys_pressure_info(
+    OUT scope text,
+    OUT resource text,
+    OUT some_avg10 float8,
+    OUT some_avg60 float8,
+    OUT some_avg300 float8,
+    OUT some_total_us int8,
+    OUT full_avg10 float8,
+    OUT full_avg60 float8,
+    OUT full_avg300 float8,
+    OUT full_total_us int8,
+    OUT some_delta_us int8,
+    OUT full_delta_us int8,
+    OUT delta_interval_ms float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_pressure_info() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_pressure_info() TO monitor_system_stats;
+
+-- Usage and limits of the cgroup v2 of the server
+CREATE FUNCTION pg_sys_cgroup_info(
+    OUT cgroup_path text,
+    OUT cpu_limit float8,
+    OUT cpu_period_us int8,
+    OUT cpu_usage_percent float8,
+    OUT cpu_usage_us int8,
+    OUT cpu_user_us int8,
+    OUT cpu_system_us int8,
+    OUT cpu_periods int8,
+    OUT cpu_throttled_periods int8,
+    OUT cpu_throttled_us int8,
+    OUT memory_current int8,
+    OUT memory_max int8,
+    OUT memory_high int8,
+    OUT memory_swap_current int8,
+    OUT memory_swap_max int8,
+    OUT memory_anon int8,
+    OUT memory_file int8,
+    OUT memory_kernel int8,
+    OUT memory_shmem int8,
+    OUT memory_oom_kills int8,
+    OUT io_read_bytes int8,
+    OUT io_write_bytes int8,
+    OUT io_reads int8,
+    OUT io_writes int8,
+    OUT pids_current int8,
+    OUT pids_max int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_cgroup_info() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_cgroup_info() TO monitor_system_stats;
+
+-- CPU usage of the threads of a process using the most CPU
+CREATE FUNCTION pg_sys_thread_stats(
+    IN pid int,
+    IN n int DEFAULT 10,
+    OUT tid int,
+    OUT name text,
+    OUT state text,
+    OUT cpu_usage float4,
+    OUT user_cpu_usage float4,
+    OUT system_cpu_usage float4,
+    OUT minor_faults int8,
+    OUT major_faults int8,
+    OUT running_since_seconds int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+REVOKE ALL ON FUNCTION pg_sys_thread_stats(int, int) FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_thread_stats(int, int) TO monitor_system_stats;
+
+-- Scheduler latency, context switch and page fault rates of the backends
+CREATE FUNCTION pg_sys_backend_scheduler_stats(
+    OUT pid int,
+    OUT name text,
+    OUT state text,
+    OUT run_time_percent float8,
+    OUT run_delay_percent float8,
+    OUT avg_run_delay_us float8,
+    OUT timeslices_per_sec float8,
+    OUT voluntary_switches_per_sec float8,
+    OUT involuntary_switches_per_sec float8,
+    OUT minor_faults_per_sec float8,
+    OUT major_faults_per_sec float8,
+    OUT interval_ms float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_backend_scheduler_stats() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_backend_scheduler_stats() TO monitor_system_stats;
+
+-- Disk I/O counters and rates of the backends
+CREATE FUNCTION pg_sys_backend_io(
+    OUT pid int,
+    OUT name text,
+    OUT read_bytes int8,
+    OUT write_bytes int8,
+    OUT cancelled_write_bytes int8,
+    OUT rchar int8,
+    OUT wchar int8,
+    OUT syscr int8,
+    OUT syscw int8,
+    OUT read_bytes_per_sec float8,
+    OUT write_bytes_per_sec float8,
+    OUT cancelled_write_bytes_per_sec float8,
+    OUT rchar_per_sec float8,
+    OUT wchar_per_sec float8,
+    OUT syscr_per_sec float8,
+    OUT syscw_per_sec float8,
+    OUT interval_ms float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_backend_io() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_backend_io() TO monitor_system_stats;
+
+-- Proportional and unique memory of the backends
+CREATE FUNCTION pg_sys_backend_memory(
+    OUT pid int,
+    OUT name text,
+    OUT rss_bytes int8,
+    OUT pss_bytes int8,
+    OUT pss_anon_bytes int8,
+    OUT pss_file_bytes int8,
+    OUT pss_shmem_bytes int8,
+    OUT uss_bytes int8,
+    OUT private_dirty_bytes int8,
+    OUT swap_bytes int8,
+    OUT swap_pss_bytes int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_backend_memory() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_backend_memory() TO monitor_system_stats;
+
+-- Memory, allocations and shared memory placement of the NUMA nodes
+CREATE FUNCTION pg_sys_numa_info(
+    OUT node int,
+    OUT cpus text,
+    OUT mem_total_bytes int8,
+    OUT mem_free_bytes int8,
+    OUT mem_used_bytes int8,
+    OUT file_pages_bytes int8,
+    OUT anon_pages_bytes int8,
+    OUT shmem_bytes int8,
+    OUT numa_hit int8,
+    OUT numa_miss int8,
+    OUT numa_foreign int8,
+    OUT interleave_hit int8,
+    OUT local_node int8,
+    OUT other_node int8,
+    OUT shared_memory_bytes int8,
+    OUT shared_memory_percent float4
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_numa_info() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_numa_info() TO monitor_system_stats;
+
+-- Huge page pools of each page size
+CREATE FUNCTION pg_sys_huge_pages_info(
+    OUT page_size_bytes int8,
+    OUT is_default bool,
+    OUT total_pages int8,
+    OUT free_pages int8,
+    OUT reserved_pages int8,
+    OUT surplus_pages int8,
+    OUT shared_memory_bytes int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_huge_pages_info() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_huge_pages_info() TO monitor_system_stats;
+
+-- Pages of the shared memory segment and transparent huge pages
+CREATE FUNCTION pg_sys_shared_memory_info(
+    OUT size_bytes int8,
+    OUT page_size_bytes int8,
+    OUT rss_bytes int8,
+    OUT hugetlb_bytes int8,
+    OUT anon_huge_pages_bytes int8,
+    OUT shmem_pmd_mapped_bytes int8,
+    OUT thp_enabled text,
+    OUT thp_defrag text,
+    OUT thp_shmem_enabled text,
+    OUT compact_stall int8,
+    OUT compact_fail int8,
+    OUT compact_success int8,
+    OUT thp_fault_alloc int8,
+    OUT thp_fault_fallback int8,
+    OUT thp_collapse_alloc int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_shared_memory_info() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_shared_memory_info() TO monitor_system_stats;
+
+-- Interrupts and softirqs serviced by each CPU
+CREATE FUNCTION pg_sys_interrupts_info(
+    IN n int DEFAULT 10,
+    OUT source text,
+    OUT name text,
+    OUT description text,
+    OUT cpu int,
+    OUT count int8,
+    OUT per_sec float8,
+    OUT interval_ms float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+REVOKE ALL ON FUNCTION pg_sys_interrupts_info(int) FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_interrupts_info(int) TO monitor_system_stats;
+
+-- Virtual memory event counters of the kernel and their rates
+CREATE FUNCTION pg_sys_vmstat(
+    OUT name text,
+    OUT value int8,
+    OUT per_sec float8,
+    OUT interval_ms float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_sys_vmstat() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_sys_vmstat() TO monitor_system_stats;
@@ -23,6 +23,8 @@
 #include "pgstat.h"
 #include "port.h"
 #include "storage/fd.h"
+#include "utils/array.h"
+#include "utils/guc.h"
 #include "utils/timestamp.h"
 
 PG_MODULE_MAGIC;
@@ -45,6 +47,26 @@ PGDLLEXPORT Datum pg_sys_disk_info(PG_FUNCTION_ARGS);
 PGDLLEXPORT Datum pg_sys_process_info(PG_FUNCTION_ARGS);
 PGDLLEXPORT Datum pg_sys_network_info(PG_FUNCTION_ARGS);
 PGDLLEXPORT Datum pg_sys_cpu_memory_by_process(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_cpu_memory_by_process_pids(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_cpu_memory_by_process_name(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_top_processes(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_backend_resource_usage(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_cpu_usage_per_core(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_memory_info_detailed(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_history(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_history_info(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_io_rates(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_pressure_info(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_cgroup_info(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_thread_stats(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_backend_scheduler_stats(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_backend_io(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_backend_memory(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_numa_info(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_huge_pages_info(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_shared_memory_info(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_interrupts_info(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum pg_sys_vmstat(PG_FUNCTION_ARGS);
 
 void initialize_wmi_connection();
 void uninitialize_wmi_connection();
@@ -60,6 +82,26 @@ PG_FUNCTION_INFO_V1(pg_sys_disk_info);
 PG_FUNCTION_INFO_V1(pg_sys_process_info);
 PG_FUNCTION_INFO_V1(pg_sys_network_info);
 PG_FUNCTION_INFO_V1(pg_sys_cpu_memory_by_process);
+PG_FUNCTION_INFO_V1(pg_sys_cpu_memory_by_process_pids);
+PG_FUNCTION_INFO_V1(pg_sys_cpu_memory_by_process_name);
+PG_FUNCTION_INFO_V1(pg_sys_top_processes);
+PG_FUNCTION_INFO_V1(pg_sys_backend_resource_usage);
+PG_FUNCTION_INFO_V1(pg_sys_cpu_usage_per_core);
+PG_FUNCTION_INFO_V1(pg_sys_memory_info_detailed);
+PG_FUNCTION_INFO_V1(pg_sys_history);
+PG_FUNCTION_INFO_V1(pg_sys_history_info);
+PG_FUNCTION_INFO_V1(pg_sys_io_rates);
+PG_FUNCTION_INFO_V1(pg_sys_pressure_info);
+PG_FUNCTION_INFO_V1(pg_sys_cgroup_info);
+PG_FUNCTION_INFO_V1(pg_sys_thread_stats);
+PG_FUNCTION_INFO_V1(pg_sys_backend_scheduler_stats);
+PG_FUNCTION_INFO_V1(pg_sys_backend_io);
+PG_FUNCTION_INFO_V1(pg_sys_backend_memory);
+PG_FUNCTION_INFO_V1(pg_sys_numa_info);
+PG_FUNCTION_INFO_V1(pg_sys_huge_pages_info);
+PG_FUNCTION_INFO_V1(pg_sys_shared_memory_info);
+PG_FUNCTION_INFO_V1(pg_sys_interrupts_info);
+PG_FUNCTION_INFO_V1(pg_sys_vmstat);
 
 void _PG_init(void)
 {
@@ -68,6 +110,18 @@ void _PG_init(void)
 #ifdef WIN32
 	initialize_wmi_connection();
 #endif
+#ifdef __linux__
+	InitSystemStatsSampler();
+	InitDiskInfoFilters();
+	InitCgroupInfo();
+#endif
+
+	/* all the GUCs of the extension are defined, reserve their prefix */
+#if PG_VERSION_NUM >= 150000
+	MarkGUCPrefixReserved("system_stats");
+#else
+	EmitWarningsOnPlaceholders("system_stats");
+#endif
 }
 
 void _PG_fini(void)
@@ -620,3 +674,1139 @@ pg_sys_cpu_memory_by_process(PG_FUNCTION_ARGS)
 
 	return (Datum) 0;
 }
+
+/*
+ * pg_sys_cpu_memory_by_process_pids
+ *
+ * This function will give cpu and memory usage of the given process IDs
+ *
+ */
+Datum
+pg_sys_cpu_memory_by_process_pids(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	ArrayType       *pid_array = PG_GETARG_ARRAYTYPE_P(0);
+	Datum           *pid_datums;
+	bool            *pid_nulls;
+	int             num_datums;
+	int             *pids;
+	int             num_pids = 0;
+	int             index;
+	/*
+	 * Tuple descriptor describing the result of cpu and memory information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_cpu_memory_info_by_process);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* NULL elements of the array do not match any process */
+	deconstruct_array(pid_array, INT4OID, sizeof(int32), true, 'i',
+					  &pid_datums, &pid_nulls, &num_datums);
+
+	pids = (int *) palloc(Max(num_datums, 1) * sizeof(int));
+	for (index = 0; index < num_datums; index++)
+	{
+		if (!pid_nulls[index])
+			pids[num_pids++] = DatumGetInt32(pid_datums[index]);
+	}
+
+	/* Fetch the system cpu and memory usage of the given processes */
+	ReadCPUMemoryByProcessPids(tupstore, tupdesc, pids, num_pids);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_cpu_memory_by_process_name
+ *
+ * This function will give cpu and memory usage of the processes whose name
+ * matches the given LIKE pattern
+ *
+ */
+Datum
+pg_sys_cpu_memory_by_process_name(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	char            *name_pattern = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	/*
+	 * Tuple descriptor describing the result of cpu and memory information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_cpu_memory_info_by_process);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the system cpu and memory usage of the matching processes */
+	ReadCPUMemoryByProcessName(tupstore, tupdesc, name_pattern);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_top_processes
+ *
+ * This function will give cpu and memory usage of the n processes using
+ * the most cpu or memory
+ *
+ */
+Datum
+pg_sys_top_processes(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int32           num_processes = PG_GETARG_INT32(0);
+	char            *order_by = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	process_order   order;
+	/*
+	 * Tuple descriptor describing the result of cpu and memory information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	if (num_processes < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("number of processes must not be negative")));
+
+	if (pg_strcasecmp(order_by, "cpu") == 0)
+		order = PROCESS_ORDER_CPU;
+	else if (pg_strcasecmp(order_by, "memory") == 0)
+		order = PROCESS_ORDER_MEMORY;
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("invalid order \"%s\"", order_by),
+					errhint("Valid orders are \"cpu\" and \"memory\".")));
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_cpu_memory_info_by_process);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the processes using the most cpu or memory */
+	ReadTopProcesses(tupstore, tupdesc, num_processes, order);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_backend_resource_usage
+ *
+ * This function will give cpu, memory and page faults of the backends
+ *
+ */
+Datum
+pg_sys_backend_resource_usage(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of backend resource usage
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_backend_resource_usage);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the resource usage of the backends */
+	ReadBackendResourceUsage(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_cpu_usage_per_core
+ *
+ * This function will give the CPU usage of each CPU
+ *
+ */
+Datum
+pg_sys_cpu_usage_per_core(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of per CPU usage information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_cpu_usage_per_core);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the usage of each CPU */
+	ReadCPUUsagePerCore(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_memory_info_detailed
+ *
+ * This function will give all the memory information reported by the system
+ *
+ */
+Datum
+pg_sys_memory_info_detailed(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of detailed memory information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_memory_info_detailed);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch all the fields of the memory information */
+	ReadMemoryInformationDetailed(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_history
+ *
+ * This function will give the samples of the history taken between two
+ * timestamps
+ *
+ */
+Datum
+pg_sys_history(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TimestampTz     start_time = PG_GETARG_TIMESTAMPTZ(0);
+	TimestampTz     end_time = PG_GETARG_TIMESTAMPTZ(1);
+	/*
+	 * Tuple descriptor describing the result of history information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_history);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the samples of the history in the range */
+	ReadHistory(tupstore, tupdesc, start_time, end_time);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_history_info
+ *
+ * This function will give the state of the history file
+ *
+ */
+Datum
+pg_sys_history_info(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of history file information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_history_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the state of the history file */
+	ReadHistoryInfo(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_io_rates
+ *
+ * This function will give the I/O rates of each block device
+ *
+ */
+Datum
+pg_sys_io_rates(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of I/O rates information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_io_rates);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the I/O rates of each block device */
+	ReadIORates(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_pressure_info
+ *
+ * This function will give the pressure stall information of the system and cgroup
+ *
+ */
+Datum
+pg_sys_pressure_info(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of pg_sys_pressure_info
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_pressure_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the pressure stall information */
+	ReadPressureInformation(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_cgroup_info
+ *
+ * This function will give the resource usage and limits of the cgroup of the server
+ *
+ */
+Datum
+pg_sys_cgroup_info(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of pg_sys_cgroup_info
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_cgroup_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the cgroup information */
+	ReadCgroupInformation(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_thread_stats
+ *
+ * This function will give cpu usage of the n threads of a process using
+ * the most cpu
+ *
+ */
+Datum
+pg_sys_thread_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int32           pid = PG_GETARG_INT32(0);
+	int32           num_threads = PG_GETARG_INT32(1);
+	/*
+	 * Tuple descriptor describing the result of thread information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	if (num_threads < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("number of threads must not be negative")));
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_thread_stats);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Fetch the threads of the process using the most cpu */
+	ReadThreadStatistics(tupstore, tupdesc, pid, num_threads);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_backend_scheduler_stats
+ *
+ * This function will give scheduler latency, context switch and page fault rates of the backends
+ *
+ */
+Datum
+pg_sys_backend_scheduler_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of scheduler statistics of the backends
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_backend_sched_stats);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the scheduler statistics of the backends */
+	ReadBackendSchedulerStatistics(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_backend_io
+ *
+ * This function will give disk I/O counters and rates of the backends
+ *
+ */
+Datum
+pg_sys_backend_io(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of backend I/O
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_backend_io);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the I/O counters of the backends */
+	ReadBackendIOStatistics(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_backend_memory
+ *
+ * This function will give the proportional and unique memory of the backends
+ *
+ */
+Datum
+pg_sys_backend_memory(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of backend memory
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_backend_memory);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the proportional memory of the backends */
+	ReadBackendMemoryStatistics(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_numa_info
+ *
+ * This function will give memory, allocation and shared memory placement statistics of the NUMA nodes
+ *
+ */
+Datum
+pg_sys_numa_info(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of NUMA information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_numa_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the NUMA information */
+	ReadNumaInformation(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_huge_pages_info
+ *
+ * This function will give the huge page pools of each page size
+ *
+ */
+Datum
+pg_sys_huge_pages_info(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of huge pages information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_huge_pages_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the huge page pools */
+	ReadHugePagesInformation(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_shared_memory_info
+ *
+ * This function will give the pages of the shared memory segment and the transparent huge page settings
+ *
+ */
+Datum
+pg_sys_shared_memory_info(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of shared memory information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_shared_memory_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the pages of the shared memory segment */
+	ReadSharedMemoryInformation(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_interrupts_info
+ *
+ * This function will give the interrupts and softirqs serviced by each CPU, for the n busiest IRQ lines
+ *
+ */
+Datum
+pg_sys_interrupts_info(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int32           num_lines = PG_GETARG_INT32(0);
+	/*
+	 * Tuple descriptor describing the result of interrupts information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	if (num_lines < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					errmsg("number of interrupt lines must not be negative")));
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_interrupts_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the interrupts serviced by each CPU */
+	ReadInterruptsInformation(tupstore, tupdesc, num_lines);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_sys_vmstat
+ *
+ * This function will give the virtual memory event counters of the kernel and their rates
+ *
+ */
+Datum
+pg_sys_vmstat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	/*
+	 * Tuple descriptor describing the result of vmstat information
+	 */
+	TupleDesc       tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext   per_query_ctx;
+	MemoryContext   oldcontext;
+
+	// check to see if caller supports us returning a tuplestore
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					errmsg("materialize mode required, but it is not allowed in this context")));
+
+	// Switch into long-lived context to construct returned data structures
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	// Build a tuple descriptor for our result type
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == Natts_vmstat_info);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Read the virtual memory event counters */
+	ReadVmstatInformation(tupstore, tupdesc);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -16,6 +16,7 @@
 #endif
 
 #include "access/tupdesc.h"
+#include "datatype/timestamp.h"
 #include "utils/tuplestore.h"
 #include "utils/builtins.h"
 
@@ -24,12 +25,20 @@ void ReadDiskInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
 /* prototypes for system IO analysis functions */
 void ReadIOAnalysisInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadIORates(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for pressure stall information functions */
+void ReadPressureInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for cgroup information functions */
+void ReadCgroupInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
 /* prototypes for system CPU information functions */
 void ReadCPUInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
 /* prototypes for system memory information functions */
 void ReadMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadMemoryInformationDetailed(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
 /* prototypes for system load average information functions */
 void ReadLoadAvgInformations(Tuplestorestate *tupstore, TupleDesc tupdesc);
@@ -40,6 +49,9 @@ void ReadOSInformations(Tuplestorestate *tupstore, TupleDesc tupdesc);
 /* prototypes for system CPU usage information functions */
 void ReadCPUUsageStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
+/* prototypes for per CPU usage information functions */
+void ReadCPUUsagePerCore(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
 /* prototypes for system process information functions */
 void ReadProcessInformations(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
@@ -49,6 +61,52 @@ void ReadNetworkInformations(Tuplestorestate *tupstore, TupleDesc tupdesc);
 /* prototypes for system network information functions */
 void ReadCPUMemoryByProcess(Tuplestorestate *tupstore, TupleDesc tupdesc);
 
+/* prototypes for CPU and memory usage of selected processes */
+void ReadCPUMemoryByProcessPids(Tuplestorestate *tupstore, TupleDesc tupdesc, int *pids, int num_pids);
+void ReadCPUMemoryByProcessName(Tuplestorestate *tupstore, TupleDesc tupdesc, const char *name_pattern);
+
+/* order of the processes returned by pg_sys_top_processes */
+typedef enum process_order
+{
+	PROCESS_ORDER_CPU,
+	PROCESS_ORDER_MEMORY
+} process_order;
+
+/* prototypes for top processes by CPU or memory usage functions */
+void ReadTopProcesses(Tuplestorestate *tupstore, TupleDesc tupdesc, int num_processes, process_order order_by);
+
+/* prototypes for scheduler statistics of the backends functions */
+void ReadBackendSchedulerStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for vmstat information functions */
+void ReadVmstatInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for interrupts information functions */
+void ReadInterruptsInformation(Tuplestorestate *tupstore, TupleDesc tupdesc, int num_lines);
+
+/* prototypes for huge pages and shared memory information functions */
+void ReadHugePagesInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+void ReadSharedMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for NUMA information functions */
+void ReadNumaInformation(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for proportional memory of the backends functions */
+void ReadBackendMemoryStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for I/O of the backends functions */
+void ReadBackendIOStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for CPU usage of the threads of a process functions */
+void ReadThreadStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc, int pid, int num_threads);
+
+/* prototypes for resource usage of the backends functions */
+void ReadBackendResourceUsage(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
+/* prototypes for history of system statistics functions */
+void ReadHistory(Tuplestorestate *tupstore, TupleDesc tupdesc, TimestampTz start_time, TimestampTz end_time);
+void ReadHistoryInfo(Tuplestorestate *tupstore, TupleDesc tupdesc);
+
 #ifndef WIN32
 /* prototypes for common string manipulations and command execution functions */
 bool stringIsNumber(char *str);
@@ -63,9 +121,6 @@ void ReadFileContent(const char *file_name, uint64 *data);
 /* prototypes for system disk information functions */
 bool ignoreFileSystemTypes(char *fs_mnt);
 bool ignoreMountPoints(char *fs_mnt);
-
-/* prototypes for system memory information functions */
-uint64_t ConvertToBytes(char *line_buf);
 #else
 void initialize_wmi_connection();
 void uninitialize_wmi_connection();
@@ -74,6 +129,297 @@ IEnumWbemClassObject* execute_query(BSTR query);
 int is_process_running(int pid);
 #endif
 
+#ifdef __linux__
+/* structure used to store the time spent by CPUs in each mode */
+struct cpu_stat
+{
+	long long int usermode_normal_process;
+	long long int usermode_niced_process;
+	long long int kernelmode_process;
+	long long int idle_mode;
+	long long int io_completion;
+	long long int servicing_irq;
+	long long int servicing_softirq;
+	long long int steal_time;
+	long long int guest_mode;
+	long long int guest_niced_mode;
+};
+
+/* structure used to store the time spent by one CPU in each mode */
+typedef struct cpu_core_stat
+{
+	int             cpu_id;
+	struct cpu_stat stat;
+} cpu_core_stat;
+
+/* prototypes for system CPU usage information functions */
+void cpu_stat_information(struct cpu_stat* cpu_stat);
+int ReadCPUCoreStats(cpu_core_stat **core_stats);
+uint64 ReadTotalCPUUsage(void);
+
+/*
+ * fields of /proc/meminfo, in the order of the columns returned by
+ * pg_sys_memory_info_detailed
+ */
+typedef enum meminfo_field
+{
+	MEMINFO_MEM_TOTAL,               /* MemTotal */
+	MEMINFO_MEM_FREE,                /* MemFree */
+	MEMINFO_MEM_AVAILABLE,           /* MemAvailable */
+	MEMINFO_BUFFERS,                 /* Buffers */
+	MEMINFO_CACHED,                  /* Cached */
+	MEMINFO_SWAP_CACHED,             /* SwapCached */
+	MEMINFO_ACTIVE,                  /* Active */
+	MEMINFO_INACTIVE,                /* Inactive */
+	MEMINFO_ACTIVE_ANON,             /* Active(anon) */
+	MEMINFO_INACTIVE_ANON,           /* Inactive(anon) */
+	MEMINFO_ACTIVE_FILE,             /* Active(file) */
+	MEMINFO_INACTIVE_FILE,           /* Inactive(file) */
+	MEMINFO_UNEVICTABLE,             /* Unevictable */
+	MEMINFO_MLOCKED,                 /* Mlocked */
+	MEMINFO_SWAP_TOTAL,              /* SwapTotal */
+	MEMINFO_SWAP_FREE,               /* SwapFree */
+	MEMINFO_ZSWAP,                   /* Zswap */
+	MEMINFO_ZSWAPPED,                /* Zswapped */
+	MEMINFO_DIRTY,                   /* Dirty */
+	MEMINFO_WRITEBACK,               /* Writeback */
+	MEMINFO_ANON_PAGES,              /* AnonPages */
+	MEMINFO_MAPPED,                  /* Mapped */
+	MEMINFO_SHMEM,                   /* Shmem */
+	MEMINFO_KRECLAIMABLE,            /* KReclaimable */
+	MEMINFO_SLAB,                    /* Slab */
+	MEMINFO_SRECLAIMABLE,            /* SReclaimable */
+	MEMINFO_SUNRECLAIM,              /* SUnreclaim */
+	MEMINFO_KERNEL_STACK,            /* KernelStack */
+	MEMINFO_PAGE_TABLES,             /* PageTables */
+	MEMINFO_SEC_PAGE_TABLES,         /* SecPageTables */
+	MEMINFO_NFS_UNSTABLE,            /* NFS_Unstable */
+	MEMINFO_BOUNCE,                  /* Bounce */
+	MEMINFO_WRITEBACK_TMP,           /* WritebackTmp */
+	MEMINFO_COMMIT_LIMIT,            /* CommitLimit */
+	MEMINFO_COMMITTED_AS,            /* Committed_AS */
+	MEMINFO_VMALLOC_TOTAL,           /* VmallocTotal */
+	MEMINFO_VMALLOC_USED,            /* VmallocUsed */
+	MEMINFO_VMALLOC_CHUNK,           /* VmallocChunk */
+	MEMINFO_PERCPU,                  /* Percpu */
+	MEMINFO_HARDWARE_CORRUPTED,      /* HardwareCorrupted */
+	MEMINFO_ANON_HUGE_PAGES,         /* AnonHugePages */
+	MEMINFO_SHMEM_HUGE_PAGES,        /* ShmemHugePages */
+	MEMINFO_SHMEM_PMD_MAPPED,        /* ShmemPmdMapped */
+	MEMINFO_FILE_HUGE_PAGES,         /* FileHugePages */
+	MEMINFO_FILE_PMD_MAPPED,         /* FilePmdMapped */
+	MEMINFO_CMA_TOTAL,               /* CmaTotal */
+	MEMINFO_CMA_FREE,                /* CmaFree */
+	MEMINFO_UNACCEPTED,              /* Unaccepted */
+	MEMINFO_BALLOON,                 /* Balloon */
+	MEMINFO_HUGE_PAGES_TOTAL,        /* HugePages_Total */
+	MEMINFO_HUGE_PAGES_FREE,         /* HugePages_Free */
+	MEMINFO_HUGE_PAGES_RSVD,         /* HugePages_Rsvd */
+	MEMINFO_HUGE_PAGES_SURP,         /* HugePages_Surp */
+	MEMINFO_HUGEPAGESIZE,            /* Hugepagesize */
+	MEMINFO_HUGETLB,                 /* Hugetlb */
+	MEMINFO_DIRECT_MAP_4K,           /* DirectMap4k */
+	MEMINFO_DIRECT_MAP_2M,           /* DirectMap2M */
+	MEMINFO_DIRECT_MAP_1G,           /* DirectMap1G */
+	MEMINFO_NUM_FIELDS
+} meminfo_field;
+
+/*
+ * structure used to store the fields of /proc/meminfo. Sizes are in bytes,
+ * the HugePages_* fields are numbers of pages. Fields the running kernel
+ * does not report are not present.
+ */
+typedef struct meminfo_stats
+{
+	uint64             values[MEMINFO_NUM_FIELDS];
+	bool               present[MEMINFO_NUM_FIELDS];
+} meminfo_stats;
+
+/* prototypes for /proc/meminfo parser functions */
+bool ReadMemInfo(meminfo_stats *stats);
+
+/* prototypes for counters of the whole system, used by the history */
+bool ReadLoadAverages(float4 *one_minute, float4 *five_minutes, float4 *fifteen_minutes);
+bool ReadDiskIOTotals(uint64 *reads, uint64 *writes, uint64 *read_bytes, uint64 *write_bytes);
+bool ReadNetDevTotals(uint64 *rx_bytes, uint64 *tx_bytes, uint64 *rx_packets, uint64 *tx_packets);
+
+/* resources and scopes of the pressure stall information */
+typedef enum psi_resource
+{
+	PSI_CPU,
+	PSI_MEMORY,
+	PSI_IO,
+	PSI_NUM_RESOURCES
+} psi_resource;
+
+typedef enum psi_scope
+{
+	PSI_SCOPE_SYSTEM,
+	PSI_SCOPE_CGROUP,
+	PSI_NUM_SCOPES
+} psi_scope;
+
+/* structure used to store one "some" or "full" line of a pressure file */
+typedef struct psi_stat
+{
+	bool               present;
+	float4             avg10;
+	float4             avg60;
+	float4             avg300;
+	uint64             total_us;
+} psi_stat;
+
+/* structure used to store all the pressure files of the system and cgroup */
+typedef struct pressure_sample
+{
+	TimestampTz        sample_time;
+	psi_stat           some[PSI_NUM_SCOPES][PSI_NUM_RESOURCES];
+	psi_stat           full[PSI_NUM_SCOPES][PSI_NUM_RESOURCES];
+} pressure_sample;
+
+/* prototypes for pressure stall information functions */
+void ReadPressureSample(pressure_sample *sample);
+bool GetCgroupDirectory(char *path, int len);
+
+/*
+ * structure used to store the usage and limits of a cgroup v2. Values
+ * which are not available, and limits which are not set, are
+ * CGROUP_VALUE_UNSET.
+ */
+#define CGROUP_VALUE_UNSET       (-1)
+
+typedef struct cgroup_stats
+{
+	char               path[MAXPGPATH];
+	int64              cpu_quota_us;
+	int64              cpu_period_us;
+	int64              cpu_usage_us;
+	int64              cpu_user_us;
+	int64              cpu_system_us;
+	int64              cpu_periods;
+	int64              cpu_throttled_periods;
+	int64              cpu_throttled_us;
+	int64              memory_current;
+	int64              memory_max;
+	int64              memory_high;
+	int64              memory_swap_current;
+	int64              memory_swap_max;
+	int64              memory_anon;
+	int64              memory_file;
+	int64              memory_kernel;
+	int64              memory_shmem;
+	int64              memory_oom_kills;
+	int64              io_read_bytes;
+	int64              io_write_bytes;
+	int64              io_reads;
+	int64              io_writes;
+	int64              pids_current;
+	int64              pids_max;
+} cgroup_stats;
+
+/* prototypes for cgroup functions */
+void InitCgroupInfo(void);
+bool ReadCgroupStats(cgroup_stats *stats);
+bool ReadCgroupMemory(uint64 *total_memory, uint64 *used_memory, uint64 *cache_memory,
+					  uint64 *swap_total, uint64 *swap_used);
+
+/* structure used to store the fields of /proc/<pid>/stat of one process */
+#define PROCESS_NAME_LEN         32
+
+typedef struct process_stat
+{
+	int                pid;
+	int                ppid;
+	char               state;
+	int                num_threads;
+	unsigned long long start_time;
+	unsigned long long minor_faults;
+	unsigned long long major_faults;
+	unsigned long long utime_ticks;
+	unsigned long long stime_ticks;
+	unsigned long long cpu_ticks;
+	unsigned long long rss_pages;
+	char               name[PROCESS_NAME_LEN];
+} process_stat;
+
+/*
+ * structure used to store a snapshot of all processes, in the order they
+ * were read, with an open addressing hash table keyed by (pid, start time)
+ * on top of it. slots hold the entry index plus one.
+ */
+typedef struct process_snapshot
+{
+	TimestampTz        snapshot_time;
+	uint64             total_cpu_ticks;
+	process_stat       *entries;
+	int                num_entries;
+	int                max_entries;
+	int                *slots;
+	int                num_slots;
+} process_snapshot;
+
+/* prototypes for process snapshot functions */
+bool TakeProcessSnapshot(process_snapshot *snapshot);
+bool TakeProcessSnapshotOfPids(process_snapshot *snapshot, const int *pids, int num_pids);
+bool TakeThreadSnapshot(process_snapshot *snapshot, int pid);
+process_stat *LookupProcessSnapshot(process_snapshot *snapshot, int pid, unsigned long long start_time);
+void FreeProcessSnapshot(process_snapshot *snapshot);
+process_snapshot *GetStatementProcessSnapshot(void);
+int *ReadBackendPids(int *num_pids);
+
+/* structure used to read the entries of a /proc directory in batches */
+#define PROC_DIR_READ_BUF_SIZE   32768
+#define PROC_FILE_INITIAL_BUF_SIZE 8192
+#define PROC_FILE_CACHE_SIZE     16
+
+/* aligned for the 64 bit fields of the entries returned by getdents64 */
+typedef union proc_dir_buffer
+{
+	char               data[PROC_DIR_READ_BUF_SIZE];
+	uint64             force_align_u64;
+} proc_dir_buffer;
+
+typedef struct proc_dir_reader
+{
+	int                dir_fd;
+	int                buf_len;
+	int                buf_pos;
+	proc_dir_buffer    buf;
+} proc_dir_reader;
+
+/* prototypes for low level /proc reader functions */
+bool ProcDirOpen(proc_dir_reader *reader, const char *path);
+const char *ProcDirNextEntry(proc_dir_reader *reader);
+const char *ProcDirNextNumericEntry(proc_dir_reader *reader);
+void ProcDirClose(proc_dir_reader *reader);
+int ReadProcFileAt(int dir_fd, const char *path, char *buf, int buf_size);
+char *ReadProcFile(const char *path, int *len);
+char *ReadCachedProcFile(const char *path, int *len);
+
+/* prototypes for system disk information functions */
+void InitDiskInfoFilters(void);
+
+/*
+ * age after which the previous sample kept by a backend is not used anymore
+ * to compute rates, see PreviousSampleExpired
+ */
+#define PREVIOUS_SAMPLE_MAX_AGE_MS    60000
+
+/* prototypes for functions computing rates between two samples */
+bool PreviousSampleExpired(TimestampTz sample_time);
+void WaitSampleInterval(TimestampTz first_sample_time, int interval_ms);
+
+/* prototypes for background sampler functions */
+void InitSystemStatsSampler(void);
+bool ReadLatestCPUSamples(struct cpu_stat *first_sample, struct cpu_stat *second_sample);
+bool ReadLatestPressureSamples(pressure_sample *first_sample, pressure_sample *second_sample);
+PGDLLEXPORT void SystemStatsSamplerMain(Datum main_arg);
+
+/* prototypes for history functions */
+void InitSystemStatsHistory(void);
+void TakeHistorySample(void);
+#endif
+
 /* read the the output of command in chunk of 1024 bytes */
 #define READ_CHUNK_BYTES     1024
 #define MIN_BUFFER_SIZE      512
@@ -86,6 +432,8 @@ int is_process_running(int pid);
 #define FILE_SYSTEM_MOUNT_FILE_NAME              "/etc/mtab"
 #define IGNORE_MOUNT_POINTS_REGEX                "^/(dev|proc|sys|run|snap|var/lib/docker/.+)($|/)"
 #define IGNORE_FILE_SYSTEM_TYPE_REGEX            "^(autofs|binfmt_misc|bpf|cgroup2?|configfs|debugfs|devpts|devtmpfs|fusectl|hugetlbfs|iso9660|mqueue|nsfs|overlay|proc|procfs|pstore|rpc_pipefs|securityfs|selinuxfs|squashfs|sysfs|tracefs)$"
+#define IGNORE_MOUNT_POINTS_DEFAULT              "/dev, /proc, /sys, /run, /snap, /var/lib/docker/"
+#define IGNORE_FILE_SYSTEM_TYPES_DEFAULT         "autofs, binfmt_misc, bpf, cgroup, cgroup2, configfs, debugfs, devpts, devtmpfs, fusectl, hugetlbfs, iso9660, mqueue, nsfs, overlay, proc, procfs, pstore, rpc_pipefs, securityfs, selinuxfs, squashfs, sysfs, tracefs"
 #define Anum_disk_mount_point                    0
 #define Anum_disk_file_system                    1
 #define Anum_disk_drive_letter                   2
@@ -109,6 +457,27 @@ int is_process_running(int pid);
 #define Anum_read_time_ms                        5
 #define Anum_write_time_ms                       6
 
+/* Macros for I/O rates of block devices */
+#define Natts_io_rates                           18
+#define Anum_io_rates_device_name                0
+#define Anum_io_rates_reads                      1
+#define Anum_io_rates_writes                     2
+#define Anum_io_rates_discards                   3
+#define Anum_io_rates_flushes                    4
+#define Anum_io_rates_read_mb                    5
+#define Anum_io_rates_write_mb                   6
+#define Anum_io_rates_discard_mb                 7
+#define Anum_io_rates_reads_merged               8
+#define Anum_io_rates_writes_merged              9
+#define Anum_io_rates_read_await                 10
+#define Anum_io_rates_write_await                11
+#define Anum_io_rates_discard_await              12
+#define Anum_io_rates_flush_await                13
+#define Anum_io_rates_await                      14
+#define Anum_io_rates_avg_queue_size             15
+#define Anum_io_rates_util                       16
+#define Anum_io_rates_in_flight                  17
+
 /* Macros for system CPU information */
 #define Natts_cpu_info                           16
 #define CPU_INFO_FILE_NAME                       "/proc/cpuinfo"
@@ -130,7 +499,6 @@ int is_process_running(int pid);
 #define Anum_l3cache_size                        15
 
 /* Macros for Memory information */
-#define MEMORY_READ_COUNT                        5
 #define Natts_memory_info                        12
 #define MEMORY_FILE_NAME                         "/proc/meminfo"
 #define Anum_total_memory                        0
@@ -146,6 +514,9 @@ int is_process_running(int pid);
 #define Anum_total_page_file                     10
 #define Anum_avail_page_file                     11
 
+/* Macros for detailed memory information, one column per meminfo_field */
+#define Natts_memory_info_detailed               58
+
 /* Macros for load average information */
 #define CPU_IO_LOAD_AVG_FILE                     "/proc/loadavg"
 #define Natts_load_avg_info                      4
@@ -186,6 +557,20 @@ int is_process_running(int pid);
 #define Anum_percent_privileged_time             9
 #define Anum_percent_interrupt_time              10
 
+/* Macros for per CPU usage information */
+#define Natts_cpu_usage_per_core                 11
+#define Anum_core_cpu_id                         0
+#define Anum_core_usermode_normal_process        1
+#define Anum_core_usermode_niced_process         2
+#define Anum_core_kernelmode_process             3
+#define Anum_core_idle_mode                      4
+#define Anum_core_io_completion                  5
+#define Anum_core_servicing_irq                  6
+#define Anum_core_servicing_softirq              7
+#define Anum_core_steal_time                     8
+#define Anum_core_guest_mode                     9
+#define Anum_core_guest_niced_mode               10
+
 /* Macros for system processes information */
 #define Natts_process_info                       5
 #define Anum_no_of_total_processes               0
@@ -196,6 +581,7 @@ int is_process_running(int pid);
 
 /* Macros for network information */
 #define Natts_network_info                       11
+#define NET_DEV_STATS_FILE_NAME                  "/proc/net/dev"
 #define Anum_net_interface_name                  0
 #define Anum_net_ipv4_address                    1
 #define Anum_net_tx_bytes                        2
@@ -218,4 +604,246 @@ int is_process_running(int pid);
 #define Anum_percent_memory_usage                4
 #define Anum_process_memory_bytes                5
 
+/* Macros for scheduler statistics of the backends */
+#define Natts_backend_sched_stats                12
+#define Anum_sched_pid                           0
+#define Anum_sched_name                          1
+#define Anum_sched_state                         2
+#define Anum_sched_run_time_percent              3
+#define Anum_sched_run_delay_percent             4
+#define Anum_sched_avg_run_delay_us              5
+#define Anum_sched_timeslices_per_sec            6
+#define Anum_sched_voluntary_switches_per_sec    7
+#define Anum_sched_involuntary_switches_per_sec  8
+#define Anum_sched_minor_faults_per_sec          9
+#define Anum_sched_major_faults_per_sec          10
+#define Anum_sched_interval_ms                   11
+
+/* Macros for vmstat information */
+#define Natts_vmstat_info                               4
+#define Anum_vmstat_name                                0
+#define Anum_vmstat_value                               1
+#define Anum_vmstat_per_sec                             2
+#define Anum_vmstat_interval_ms                         3
+
+/* Macros for interrupts information */
+#define SOFTIRQS_FILE_NAME                              "/proc/softirqs"
+#define INTERRUPTS_FILE_NAME                            "/proc/interrupts"
+#define Natts_interrupts_info                           7
+#define Anum_interrupts_source                          0
+#define Anum_interrupts_name                            1
+#define Anum_interrupts_description                     2
+#define Anum_interrupts_cpu                             3
+#define Anum_interrupts_count                           4
+#define Anum_interrupts_per_sec                         5
+#define Anum_interrupts_interval_ms                     6
+
+/* Macros for huge pages information */
+#define HUGE_PAGES_DIRECTORY                            "/sys/kernel/mm/hugepages"
+#define Natts_huge_pages_info                           7
+#define Anum_huge_pages_page_size                       0
+#define Anum_huge_pages_is_default                      1
+#define Anum_huge_pages_total                           2
+#define Anum_huge_pages_free                            3
+#define Anum_huge_pages_reserved                        4
+#define Anum_huge_pages_surplus                         5
+#define Anum_huge_pages_shared_memory_bytes             6
+
+/* Macros for shared memory segment and transparent huge pages information */
+#define THP_DIRECTORY                                   "/sys/kernel/mm/transparent_hugepage"
+#define VMSTAT_FILE_NAME                                "/proc/vmstat"
+#define Natts_shared_memory_info                        15
+#define Anum_shared_memory_size                         0
+#define Anum_shared_memory_page_size                    1
+#define Anum_shared_memory_rss                          2
+#define Anum_shared_memory_hugetlb                      3
+#define Anum_shared_memory_anon_huge_pages              4
+#define Anum_shared_memory_shmem_pmd_mapped             5
+#define Anum_shared_memory_thp_enabled                  6
+#define Anum_shared_memory_thp_defrag                   7
+#define Anum_shared_memory_thp_shmem_enabled            8
+#define Anum_shared_memory_compact_stall                9
+#define Anum_shared_memory_compact_fail                 10
+#define Anum_shared_memory_compact_success              11
+#define Anum_shared_memory_thp_fault_alloc              12
+#define Anum_shared_memory_thp_fault_fallback           13
+#define Anum_shared_memory_thp_collapse_alloc           14
+
+/* Macros for NUMA information */
+#define NUMA_NODE_DIRECTORY                             "/sys/devices/system/node"
+#define Natts_numa_info                                 16
+#define Anum_numa_node                                  0
+#define Anum_numa_cpus                                  1
+#define Anum_numa_mem_total_bytes                       2
+#define Anum_numa_mem_free_bytes                        3
+#define Anum_numa_mem_used_bytes                        4
+#define Anum_numa_file_pages_bytes                      5
+#define Anum_numa_anon_pages_bytes                      6
+#define Anum_numa_shmem_bytes                           7
+#define Anum_numa_hit                                   8
+#define Anum_numa_miss                                  9
+#define Anum_numa_foreign                               10
+#define Anum_numa_interleave_hit                        11
+#define Anum_numa_local_node                            12
+#define Anum_numa_other_node                            13
+#define Anum_numa_shared_memory_bytes                   14
+#define Anum_numa_shared_memory_percent                 15
+
+/* Macros for proportional memory of the backends */
+#define Natts_backend_memory                            11
+#define Anum_backend_memory_pid                         0
+#define Anum_backend_memory_name                        1
+#define Anum_backend_memory_rss_bytes                   2
+#define Anum_backend_memory_pss_bytes                   3
+#define Anum_backend_memory_pss_anon_bytes              4
+#define Anum_backend_memory_pss_file_bytes              5
+#define Anum_backend_memory_pss_shmem_bytes             6
+#define Anum_backend_memory_uss_bytes                   7
+#define Anum_backend_memory_private_dirty_bytes         8
+#define Anum_backend_memory_swap_bytes                  9
+#define Anum_backend_memory_swap_pss_bytes              10
+
+/* Macros for I/O of the backends */
+#define Natts_backend_io                                17
+#define Anum_backend_io_pid                             0
+#define Anum_backend_io_name                            1
+#define Anum_backend_io_read_bytes                      2
+#define Anum_backend_io_write_bytes                     3
+#define Anum_backend_io_cancelled_write_bytes           4
+#define Anum_backend_io_rchar                           5
+#define Anum_backend_io_wchar                           6
+#define Anum_backend_io_syscr                           7
+#define Anum_backend_io_syscw                           8
+#define Anum_backend_io_read_bytes_per_sec              9
+#define Anum_backend_io_write_bytes_per_sec             10
+#define Anum_backend_io_cancelled_write_bytes_per_sec   11
+#define Anum_backend_io_rchar_per_sec                   12
+#define Anum_backend_io_wchar_per_sec                   13
+#define Anum_backend_io_syscr_per_sec                   14
+#define Anum_backend_io_syscw_per_sec                   15
+#define Anum_backend_io_interval_ms                     16
+
+/* Macros for CPU usage of the threads of a process */
+#define Natts_thread_stats                       9
+#define Anum_thread_tid                          0
+#define Anum_thread_name                         1
+#define Anum_thread_state                        2
+#define Anum_thread_cpu_usage                    3
+#define Anum_thread_user_cpu_usage               4
+#define Anum_thread_system_cpu_usage             5
+#define Anum_thread_minor_faults                 6
+#define Anum_thread_major_faults                 7
+#define Anum_thread_running_since                8
+
+/* Macros for resource usage of the backends */
+#define Natts_backend_resource_usage             8
+#define Anum_backend_pid                         0
+#define Anum_backend_name                        1
+#define Anum_backend_state                       2
+#define Anum_backend_cpu_usage                   3
+#define Anum_backend_memory_usage                4
+#define Anum_backend_memory_bytes                5
+#define Anum_backend_minor_faults                6
+#define Anum_backend_major_faults                7
+
+/* Macros for pressure stall information */
+#define PSI_SYSTEM_DIRECTORY                     "/proc/pressure"
+#define CGROUP_MOUNT_INFO_FILE_NAME              "/proc/self/mountinfo"
+#define CGROUP_SELF_FILE_NAME                    "/proc/self/cgroup"
+#define Natts_pressure_info                      13
+#define Anum_pressure_scope                      0
+#define Anum_pressure_resource                   1
+#define Anum_pressure_some_avg10                 2
+#define Anum_pressure_some_avg60                 3
+#define Anum_pressure_some_avg300                4
+#define Anum_pressure_some_total_us              5
+#define Anum_pressure_full_avg10                 6
+#define Anum_pressure_full_avg60                 7
+#define Anum_pressure_full_avg300                8
+#define Anum_pressure_full_total_us              9
+#define Anum_pressure_some_delta_us              10
+#define Anum_pressure_full_delta_us              11
+#define Anum_pressure_delta_interval_ms          12
+
+/* Macros for cgroup information */
+#define Natts_cgroup_info                        26
+#define Anum_cgroup_path                         0
+#define Anum_cgroup_cpu_limit                    1
+#define Anum_cgroup_cpu_period_us                2
+#define Anum_cgroup_cpu_usage                    3
+#define Anum_cgroup_cpu_usage_us                 4
+#define Anum_cgroup_cpu_user_us                  5
+#define Anum_cgroup_cpu_system_us                6
+#define Anum_cgroup_cpu_periods                  7
+#define Anum_cgroup_cpu_throttled_periods        8
+#define Anum_cgroup_cpu_throttled_us             9
+#define Anum_cgroup_memory_current               10
+#define Anum_cgroup_memory_max                   11
+#define Anum_cgroup_memory_high                  12
+#define Anum_cgroup_memory_swap_current          13
+#define Anum_cgroup_memory_swap_max              14
+#define Anum_cgroup_memory_anon                  15
+#define Anum_cgroup_memory_file                  16
+#define Anum_cgroup_memory_kernel                17
+#define Anum_cgroup_memory_shmem                 18
+#define Anum_cgroup_memory_oom_kills             19
+#define Anum_cgroup_io_read_bytes                20
+#define Anum_cgroup_io_write_bytes               21
+#define Anum_cgroup_io_reads                     22
+#define Anum_cgroup_io_writes                    23
+#define Anum_cgroup_pids_current                 24
+#define Anum_cgroup_pids_max                     25
+
+/* Macros for background sampler */
+#define SAMPLER_RING_SIZE                        60
+#define SAMPLER_DEFAULT_INTERVAL_MS              1000
+#define SAMPLER_SHMEM_NAME                       "system_stats sampler"
+#define SAMPLER_TRANCHE_NAME                     "system_stats"
+
+/* Macros for history of system statistics */
+#define HISTORY_FILE_NAME                        "system_stats.history"
+#define HISTORY_TEMP_FILE_NAME                   "system_stats.history.tmp"
+#define HISTORY_FILE_MAGIC                       0x53535448
+#define HISTORY_FILE_VERSION                     1
+#define HISTORY_DEFAULT_SIZE                     8640
+#define HISTORY_DEFAULT_INTERVAL_MS              10000
+
+#define Natts_history                            28
+#define Anum_history_sample_time                 0
+#define Anum_history_usermode_normal_process     1
+#define Anum_history_usermode_niced_process      2
+#define Anum_history_kernelmode_process          3
+#define Anum_history_idle_mode                   4
+#define Anum_history_io_completion               5
+#define Anum_history_servicing_irq               6
+#define Anum_history_servicing_softirq           7
+#define Anum_history_steal_time                  8
+#define Anum_history_total_memory                9
+#define Anum_history_used_memory                 10
+#define Anum_history_free_memory                 11
+#define Anum_history_available_memory            12
+#define Anum_history_cache_memory                13
+#define Anum_history_swap_total_memory           14
+#define Anum_history_swap_used_memory            15
+#define Anum_history_swap_free_memory            16
+#define Anum_history_load_avg_one_minute         17
+#define Anum_history_load_avg_five_minutes       18
+#define Anum_history_load_avg_fifteen_minutes    19
+#define Anum_history_disk_reads                  20
+#define Anum_history_disk_writes                 21
+#define Anum_history_disk_read_bytes             22
+#define Anum_history_disk_write_bytes            23
+#define Anum_history_net_rx_bytes                24
+#define Anum_history_net_tx_bytes                25
+#define Anum_history_net_rx_packets              26
+#define Anum_history_net_tx_packets              27
+
+#define Natts_history_info                       6
+#define Anum_history_file_name                   0
+#define Anum_history_record_size                 1
+#define Anum_history_capacity                    2
+#define Anum_history_num_records                 3
+#define Anum_history_oldest_sample               4
+#define Anum_history_newest_sample               5
+
 #endif // SYSTEM_STATS_H
@@ -8,3 +8,23 @@ DROP FUNCTION pg_sys_os_info();
 DROP FUNCTION pg_sys_process_info();
 DROP FUNCTION pg_sys_network_info();
 DROP FUNCTION pg_sys_cpu_memory_by_process();
+DROP FUNCTION pg_sys_cpu_memory_by_process(int[]);
+DROP FUNCTION pg_sys_cpu_memory_by_process_name(text);
+DROP FUNCTION pg_sys_top_processes(int, text);
+DROP FUNCTION pg_sys_backend_resource_usage();
+DROP FUNCTION pg_sys_cpu_usage_per_core();
+DROP FUNCTION pg_sys_memory_info_detailed();
+DROP FUNCTION pg_sys_history(timestamptz, timestamptz);
+DROP FUNCTION pg_sys_history_info();
+DROP FUNCTION pg_sys_io_rates();
+DROP FUNCTION pg_sys_pressure_info();
+DROP FUNCTION pg_sys_cgroup_info();
+DROP FUNCTION pg_sys_thread_stats(int, int);
+DROP FUNCTION pg_sys_backend_scheduler_stats();
+DROP FUNCTION pg_sys_backend_io();
+DROP FUNCTION pg_sys_backend_memory();
+DROP FUNCTION pg_sys_numa_info();
+DROP FUNCTION pg_sys_huge_pages_info();
+DROP FUNCTION pg_sys_shared_memory_info();
+DROP FUNCTION pg_sys_interrupts_info(int);
+DROP FUNCTION pg_sys_vmstat();
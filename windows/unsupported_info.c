@@ -0,0 +1,151 @@
+/*------------------------------------------------------------------------
+ * unsupported_info.c
+ *              Functions not supported on this platform
+ *
+ * Copyright (c) 2020, EnterpriseDB Corporation. All Rights Reserved.
+ *
+ *------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "system_stats.h"
+
+void ReadCPUMemoryByProcessPids(Tuplestorestate *tupstore, TupleDesc tupdesc, int *pids, int num_pids)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("cpu and memory usage of given processes is not supported on this platform")));
+}
+
+void ReadCPUMemoryByProcessName(Tuplestorestate *tupstore, TupleDesc tupdesc, const char *name_pattern)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("cpu and memory usage of given processes is not supported on this platform")));
+}
+
+void ReadTopProcesses(Tuplestorestate *tupstore, TupleDesc tupdesc, int num_processes, process_order order_by)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("top processes are not supported on this platform")));
+}
+
+void ReadBackendResourceUsage(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("resource usage of the backends is not supported on this platform")));
+}
+
+void ReadCPUUsagePerCore(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("per CPU usage is not supported on this platform")));
+}
+
+void ReadMemoryInformationDetailed(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("detailed memory information is not supported on this platform")));
+}
+
+void ReadHistory(Tuplestorestate *tupstore, TupleDesc tupdesc, TimestampTz start_time, TimestampTz end_time)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("history of system statistics is not supported on this platform")));
+}
+
+void ReadHistoryInfo(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("history of system statistics is not supported on this platform")));
+}
+
+void ReadIORates(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("I/O rates of block devices is not supported on this platform")));
+}
+
+void ReadPressureInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("Pressure stall information is not supported on this platform")));
+}
+
+void ReadCgroupInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("cgroup information is not supported on this platform")));
+}
+
+void ReadThreadStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc, int pid, int num_threads)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("thread statistics are not supported on this platform")));
+}
+
+void ReadBackendSchedulerStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("scheduler statistics are not supported on this platform")));
+}
+
+void ReadBackendIOStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("backend I/O statistics are not supported on this platform")));
+}
+
+void ReadBackendMemoryStatistics(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("backend memory statistics are not supported on this platform")));
+}
+
+void ReadNumaInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("NUMA information is not supported on this platform")));
+}
+
+void ReadHugePagesInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("huge pages information is not supported on this platform")));
+}
+
+void ReadSharedMemoryInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("shared memory information is not supported on this platform")));
+}
+
+void ReadInterruptsInformation(Tuplestorestate *tupstore, TupleDesc tupdesc, int num_lines)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("interrupts information is not supported on this platform")));
+}
+
+void ReadVmstatInformation(Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("vmstat information is not supported on this platform")));
+}